@@ -37,8 +37,34 @@
 #include <unordered_map>
 #include <cstring>
 #include <fstream>
+#include <vector>
+#include <cstdint>
+#include <cstdio>
+#include <cctype>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <sstream>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <functional>
+#include <cmath>
+#include <climits>
+#include <iomanip>
+#include <map>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define DNA_CODEC_X86 1
+#include <immintrin.h>
+#endif
 
 #define VERSION 				1.1
+// built-in flank set, replaced at run time by --flanks or --promoter/--terminator/--marker
 #define PROMOTER 				"ATGCATGC"
 #define TERMINATOR				"TTAATTAA"
 #define MARKER 					"GGCCGGCC"
@@ -54,6 +80,211 @@ string binaryToMessage(const string &binaryStr);
 string padBinaryFileContent(const string &fileContent);
 string padStringMessage(const string &message);
 
+// encoding options, set from the command line and recorded in XFILE headers
+enum PayloadCode { plainCode = 0, rotatingCode = 1, senseCode = 2 };     // nucleotide code of -e and -i payloads
+struct CodecOptions {
+    int rsParity;       // Reed-Solomon parity bytes per 255-byte codeword, 0 for none
+    int oligoLength;    // nucleotides per oligo in segmented output
+    int oligoGroup;     // data oligos per erasure group
+    int oligoParity;    // parity oligos per erasure group, 0 for none
+    int clusterMemory;  // MiB for clustering damaged reads in -j
+    uint32_t flanks;    // identifier of the flank set, 0 for the built-in one
+    int escapeFlanks;   // 1 to keep the flanks out of -e and -i payloads
+    int payloadCode;    // PayloadCode of -e and -i payloads
+    int whitenSeed;     // keystream seed XORed into record bodies, 0 for none
+    int gcWindow;       // --screen window, in nucleotides
+    int gcMin, gcMax;   // --screen GC limits of each window, in percent
+    int maxRun;         // --screen longest allowed homopolymer
+    int translate;      // 1 for --codons to write the translation
+    uint64_t rareCodons;    // --codons rare codons, bit 16 * first + 4 * second + third base code
+    int fountainOverhead;   // -s droplets beyond the segment count, in percent, 0 for addressed stripes
+    int rankIndex;          // 1 for -i, -c and -r to write the <output>.rank sidecar
+    int kmerBloom;          // MiB of Bloom filter keeping --kmers singletons out of the tables, 0 for none
+    CodecOptions() : rsParity(0), oligoLength(200), oligoGroup(32), oligoParity(0), clusterMemory(1024), flanks(0),
+                     escapeFlanks(0), payloadCode(plainCode), whitenSeed(0), gcWindow(50), gcMin(25), gcMax(75), maxRun(6),
+                     translate(0), rareCodons(0x10014201500ULL), fountainOverhead(0), rankIndex(0), kmerBloom(0) {}
+};
+static CodecOptions codecOptions;
+int parseCodecOptions(int argc, char *argv[], CodecOptions &options);
+string formatRecordOptions(const CodecOptions &options);
+bool parseRecordOptions(const string &attributes, CodecOptions &options);
+
+// keystream whitening of record bodies
+void whitenBytes(char *data, size_t length, uint32_t seed, uint64_t offset = 0);
+
+// base composition sidecar, built as a .dna file is written
+struct BaseRankSuperblock {
+    uint64_t counts[4];         // bases of each kind before the superblock
+};
+struct BaseRankBlock {
+    uint16_t counts[4];         // bases of each kind since the superblock
+    uint64_t bases[8];          // 256 bases, 2 bits each, first base lowest
+};
+struct BaseRankBuilder {
+    uint64_t length, totals[4];
+    vector<BaseRankSuperblock> superblocks;
+    vector<BaseRankBlock> blocks;
+    bool valid;                 // false once a symbol other than A, C, G or T was fed
+
+    BaseRankBuilder() : length(0), totals(), valid(true) {}
+    void feed(const char *dnaSeq, size_t count);
+    void feed(const string &dnaSeq) { feed(dnaSeq.data(), dnaSeq.length()); }
+    string image(uint64_t sourceSize);      // the sidecar, ending the sequence
+    bool write(const string &fileName, uint64_t sourceSize);   // <fileName>.rank
+private:
+    void startBlock();
+};
+bool writeRankIndex(const string &fileName);     // from the file itself
+
+// fast byte-level codec
+string bytesToNucleotide(const string &bytes);
+void bytesToNucleotide(const unsigned char *bytes, size_t length, char *dnaSeq);
+bool nucleotideToBytes(const char *dnaSeq, size_t length, string &bytes);
+bool nucleotideToBytes(const char *dnaSeq, size_t length, unsigned char *bytes);
+
+// flank sets, approximate flank search and read orientation
+struct FlankPattern {
+    string sequence;
+    uint64_t peq[4];            // Myers match masks, bit i set where sequence[i] is the nucleotide
+    uint64_t tailPeq[4];        // the same for the sequence read back to front
+};
+struct FlankPair {
+    FlankPattern lead, trail;                   // as written on the forward strand
+    FlankPattern reverseLead, reverseTrail;     // what the reverse strand starts and ends with
+};
+struct FlankEscape {
+    size_t count;                   // flanks kept out of escaped payloads
+    uint64_t prefix[3], mask[3];    // all but the last base of each flank, 2 bits per base, newest lowest
+    unsigned char last[3];          // code of the base that would complete each flank
+    size_t prefixLength[3];
+    char prefixText[3][32];         // the prefixes as text, to confirm a prefilter hit
+    char anchor[3][4];              // last 4 bases of each prefix for the SIMD prefilter, 0 where shorter
+};
+struct FlankSet {
+    string promoter, terminator, marker;
+    uint32_t id;                // 0 for the built-in set, else a hash of the three flanks
+    FlankPair record;           // PROMOTER and TERMINATOR + MARKER around a .dna record or archive
+    FlankPair oligo;            // PROMOTER and TERMINATOR around an oligo
+    FlankEscape escape;
+};
+static FlankSet flankSet;       // active set, compiled by parseCodecOptions
+bool compileFlankSet(const string &promoter, const string &terminator, const string &marker, FlankSet &flanks);
+bool readFlankConfig(const string &fileName, string &promoter, string &terminator, string &marker);
+bool locateFlanks(const char *dnaSeq, size_t length, size_t &start, size_t &payloadLength);
+void reverseComplement(char *dnaSeq, size_t length);
+string reverseComplementOf(const string &dnaSeq);
+void reverseComplementPacked(unsigned char *bytes, size_t length);
+bool reverseStrand(const char *dnaSeq, size_t length, const FlankPair &flanks);
+
+// flank escaping
+bool escapeFlanks(const char *dnaSeq, size_t length, string &escaped);
+bool escapeFlanks(const string &bytes, string &escaped);
+bool unescapeFlanks(const char *dnaSeq, size_t length, string &dnaOut);
+bool escapedPayload(const char *dnaSeq, size_t length);
+size_t findFlank(const char *text, size_t length, const string &flank);
+
+// constrained payload codes
+string payloadCodeTag(int code);
+int taggedPayloadCode(const char *dnaSeq, size_t length, size_t &tagLength);
+void encodePayload(const string &bytes, string &dnaSeq);
+bool decodePayload(const char *dnaSeq, size_t length, string &bytes);
+void bytesToRotating(const unsigned char *bytes, size_t length, char *dnaSeq, unsigned char &previous);
+bool rotatingToBytes(const char *dnaSeq, size_t length, unsigned char *bytes, unsigned char &previous);
+void bytesToSense(const unsigned char *bytes, size_t length, char *dnaSeq);
+bool senseToBytes(const char *dnaSeq, size_t length, unsigned char *bytes);
+
+// multi-file archives
+struct ArchiveEntry {
+    string name;
+    uint64_t offset;    // nucleotide offset of the member record in the archive
+    uint64_t length;    // nucleotide length of the member record
+};
+string encodeFileRecord(const string &fileName, const string &fileContents);
+string fileRecordBytes(const string &fileName, const string &fileContents);
+bool decodeFileRecord(const string &decoded, string &fileName, string &fileContents, size_t *corrected = nullptr,
+                      const vector<size_t> &erasures = vector<size_t>());
+string encodeArchiveTail(const vector<ArchiveEntry> &entries, uint64_t indexOffset);
+bool readArchiveIndex(ifstream &archive, vector<ArchiveEntry> &entries, uint64_t &indexOffset);
+bool readNucleotideRange(ifstream &archive, uint64_t offset, uint64_t length, string &dnaSeq);
+bool recoverArchive(const string &archiveName);
+bool writeFileDurably(const string &fileName, const string &data, int flags, uint64_t offset = 0);
+
+// Reed-Solomon outer code
+size_t rsEncodedLength(size_t dataLength, int parity);
+string rsEncode(const string &data, int parity);
+bool rsDecode(const string &encoded, int parity, string &data, size_t &corrected,
+              const vector<size_t> &erasures = vector<size_t>());
+
+// cross-oligo erasure code
+struct ErasureCode {
+    int dataStripes;            // stripes per group
+    int parityStripes;
+    vector<uint8_t> matrix;     // parityStripes x dataStripes coefficients, first row all ones
+};
+ErasureCode makeErasureCode(int dataStripes, int parityStripes);
+size_t erasureGroupCount(size_t stripes, const ErasureCode &code);
+string erasureEncodeStripes(const string &stripes, size_t stripeLength, const ErasureCode &code);
+bool erasureRebuildStripes(string &stripes, vector<bool> &present, size_t stripeLength,
+                           const ErasureCode &code, size_t &rebuilt);
+
+// oligo segmentation
+struct OligoLayout {
+    size_t stripeLength;    // payload bytes per oligo
+    int groupStripes;       // data oligos per erasure group
+    int parityStripes;      // parity oligos per erasure group, 0 for none
+    bool fountain;          // stripes are fountain droplets, indexed by seed
+};
+OligoLayout oligoLayoutFor(const CodecOptions &options);
+size_t oligoSequenceLength(const OligoLayout &layout);
+uint16_t crc16(const unsigned char *data, size_t length);
+string segmentRecord(const string &record, const OligoLayout &layout);
+void formatOligo(uint32_t index, const OligoLayout &layout, const unsigned char *stripe, char *dnaSeq);
+bool writeOligoFasta(ostream &out, const string &stripes, const OligoLayout &layout,
+                     const vector<uint32_t> *indices = nullptr);
+struct FountainStats {
+    size_t segments;        // K, segments of the record
+    size_t droplets;        // droplets that went into decoding
+    size_t peeled;          // segments solved by peeling
+    size_t eliminated;      // segments solved by Gaussian elimination once peeling stalled
+};
+bool fountainEncode(const string &record, const OligoLayout &layout, const CodecOptions &options, string &stripes,
+                    vector<uint32_t> &seeds);
+bool fountainDecode(const string &stripes, const vector<bool> &present, size_t stripeLength, string &record,
+                    vector<size_t> &erasures, FountainStats &stats);
+bool decodeOligo(const char *dnaSeq, size_t length, uint32_t &index, uint8_t &layoutByte, string &stripe);
+struct SequenceRecord {
+    const char *name;           // header line after '>' or '@'
+    size_t nameLength;
+    const char *sequence;
+    size_t length;
+    const char *quality;        // nullptr for FASTA
+    size_t qualityLength;
+};
+bool forEachSequence(const string &fileName, const function<void(const SequenceRecord &)> &visit);
+
+// synthesis screening
+struct ScreenMotif {
+    string name, sequence;
+};
+bool readMotifList(const string &fileName, vector<ScreenMotif> &motifs);
+static vector<ScreenMotif> screenMotifs;     // forbidden motifs for --screen, from --motifs
+
+// codon analysis
+bool parseCodonList(const char *list, uint64_t &codons);
+void codonIndices(const char *bases, size_t codons, unsigned char *indices);
+struct OligoReadStats {
+    size_t reads, unique, invalid;
+    size_t damaged;         // reads that failed their CRC
+    size_t shifted;         // damaged reads out of the 4-nucleotide frame, realigned before voting
+    size_t reversed;        // reads of the reverse strand, turned around before decoding
+    size_t clustered;       // damaged reads moved to the index their content matches
+    size_t consensus;       // unique oligos recovered by voting across damaged reads
+    size_t unverified;      // oligos whose vote failed the CRC, placed as erasures under --rs
+};
+bool collectOligos(const vector<string> &readFiles, OligoLayout &layout, string &stripes, vector<bool> &present,
+                   vector<size_t> &erasures, OligoReadStats &stats);
+string formatIndexRanges(const vector<size_t> &indices, size_t maxRanges);
+
 // file check
 bool openFile(const string &fileName, string &contents, ios_base::openmode mode);
 
@@ -62,46 +293,203 @@ bool doStringEncode(const string& message); 	// -e
 bool doStringDecode(const string& encodedMsg); 	// -d
 bool doFileEncode(const string& filename); 		// -i
 bool doFileDecode(const string& filename);		// -o
+bool doArchiveCreate(const string& archiveName, const vector<string>& fileNames);	// -c
+bool doArchiveList(const string& archiveName);	// -t
+bool doArchiveExtract(const string& archiveName, const string& memberName);	// -x
+bool doArchiveAppend(const string& archiveName, const vector<string>& fileNames);	// -r
+bool doSegmentEncode(const string& fileName);	// -s
+bool doSegmentDecode(const vector<string>& readFiles);	// -j
+bool doBenchmark(const string& kernel);		// -b
+bool doScreen(const vector<string>& fileNames);	// --screen
+bool doCodons(const vector<string>& fileNames);	// --codons
+bool doGrep(const string& pattern, const vector<string>& fileNames);	// --grep
+bool doFmIndex(const vector<string>& fileNames);	// --fm-index
+bool doFmFind(const string& motif, const vector<string>& fileNames);	// --fm-find
+bool doComposition(const string& fileName, const vector<string>& ranges);	// --composition
+bool doKmers(const string& size, const vector<string>& fileNames);	// --kmers
+
 
 
+// Run body(begin, end) over [0, count) split across the hardware threads
+template <typename F>
+static void parallelFor(size_t count, F body) {
+    size_t threads = min<size_t>(max(1u, thread::hardware_concurrency()), count);
+    if (threads <= 1) {
+        if (count > 0) body(0, count);
+        return;
+    }
+    vector<thread> workers;
+    for (size_t t = 0; t < threads; ++t) {
+        workers.push_back(thread(body, count * t / threads, count * (t + 1) / threads));
+    }
+    for (thread &worker : workers) worker.join();
+}
+
+// Modes and options, printed when the command line cannot be run
+static void printUsage(const char *program) {
+    cerr << "Usage: " << program << " [options] [-e | -d | -i | -o] <argument>" << endl;
+    cerr << "       " << program << " [options] [-c | -r] <archive.dna> <file>..." << endl;
+    cerr << "       " << program << " [options] [-t | -x <member>] <archive.dna>" << endl;
+    cerr << "       " << program << " -b <kernel>" << endl;
+    cerr << "       " << program << " [options] -s <file>" << endl;
+    cerr << "       " << program << " [options] -j <reads.fasta|fastq>..." << endl;
+    cerr << "       " << program << " [options] --screen <file.dna|fasta|fastq>..." << endl;
+    cerr << "       " << program << " [options] --codons <file.dna|fasta|fastq>..." << endl;
+    cerr << "       " << program << " [options] --grep <pattern> <file.dna>..." << endl;
+    cerr << "       " << program << " --fm-index <file.dna>..." << endl;
+    cerr << "       " << program << " --fm-find <motif> <file.dna>..." << endl;
+    cerr << "       " << program << " --composition <file.dna> [<start>:<end>]..." << endl;
+    cerr << "       " << program << " [options] --kmers <k> <file.dna|fasta|fastq>..." << endl;
+    cerr << "Options: --rs <parity>            Reed-Solomon parity bytes per 255-byte codeword (1-128)" << endl;
+    cerr << "         --oligo-length <nt>      oligo length for -s (48-4096, default 200)" << endl;
+    cerr << "         --oligo-group <oligos>   data oligos per erasure group (8-128 by 8, default 32)" << endl;
+    cerr << "         --oligo-parity <oligos>  parity oligos per erasure group (0-15, default 0)" << endl;
+    cerr << "         --fountain <percent>     write -s output as fountain droplets, percent beyond the segments (1-1000)" << endl;
+    cerr << "         --cluster-memory <MiB>   memory for clustering damaged reads in -j (16-1048576, default 1024)" << endl;
+    cerr << "         --escape-flanks <0|1>    keep the flanks out of -e and -i payloads (default 0)" << endl;
+    cerr << "         --code <plain|rotating|sense>  nucleotide code of -e and -i payloads (default plain)" << endl;
+    cerr << "         --whiten <seed>          XOR file record bodies with a keystream from seed (1-2147483647)" << endl;
+    cerr << "         --flanks <file>          read PROMOTER, TERMINATOR and MARKER from a flank set file" << endl;
+    cerr << "         --promoter <nt>          PROMOTER flank (4-32 nt, default " PROMOTER ")" << endl;
+    cerr << "         --terminator <nt>        TERMINATOR flank (4-32 nt, default " TERMINATOR ")" << endl;
+    cerr << "         --marker <nt>            MARKER flank (4-32 nt, default " MARKER ")" << endl;
+    cerr << "         --gc-window <nt>         --screen GC window (10-100000, default 50)" << endl;
+    cerr << "         --gc-min <percent>       --screen lowest GC of a window (0-100, default 25)" << endl;
+    cerr << "         --gc-max <percent>       --screen highest GC of a window (0-100, default 75)" << endl;
+    cerr << "         --max-run <nt>           --screen longest homopolymer (1-100000, default 6)" << endl;
+    cerr << "         --motifs <file>          --screen forbidden motifs, one [name =] <nt> per line" << endl;
+    cerr << "         --rare-codons <list>     --codons rare codons, comma separated (default AGA,AGG,ATA,CCC,CGG,CTA,GGA)" << endl;
+    cerr << "         --translate <0|1>        --codons writes the translation to <file>.faa (default 0)" << endl;
+    cerr << "         --rank-index <0|1>       -i, -c and -r write the base composition sidecar <output>.rank (default 0)" << endl;
+    cerr << "         --kmer-bloom <MiB>       --kmers Bloom filter for singletons (0-65536, default 0 for none)" << endl;
+}
 
 int main(int argc, char *argv[]) {
 
-    if (argc != 3) {
-        cerr << "Usage: " << argv[0] << " [-e | -d | -i | -o] <argument>" << endl;
+    int first = parseCodecOptions(argc, argv, codecOptions);
+    if (first < 0 || argc - first < 2) {
+        printUsage(argv[0]);
         return 1;
     }
-    
-    string arg = argv[2];
+
+    const char *mode = argv[first];
+    string arg = argv[first + 1];
+    int extra = argc - first - 2;
+    bool ok;
 
     // Encoding message to DNA sequence
-    if (strcmp(argv[1], "-e") == 0) {
-    	doStringEncode(arg);
+    if (strcmp(mode, "-e") == 0) {
+    	ok = doStringEncode(arg);
     // Encoding file to DNA sequence .dna file
-    } else if (strcmp(argv[1], "-i") == 0) {
-    	doFileEncode(arg);
+    } else if (strcmp(mode, "-i") == 0) {
+    	ok = doFileEncode(arg);
     // Decoding from .dna file to original content
-    } else if (strcmp(argv[1], "-o") == 0) {
-    	doFileDecode(arg);
+    } else if (strcmp(mode, "-o") == 0) {
+    	ok = doFileDecode(arg);
     // Decoding DNA sequence to STRING message
-    } else if (strcmp(argv[1], "-d") == 0) {
-    	doStringDecode(arg);
+    } else if (strcmp(mode, "-d") == 0) {
+    	ok = doStringDecode(arg);
+    // Creating a multi-file .dna archive
+    } else if (strcmp(mode, "-c") == 0 && extra > 0) {
+        ok = doArchiveCreate(arg, vector<string>(argv + first + 2, argv + argc));
+    // Appending files to an existing .dna archive
+    } else if (strcmp(mode, "-r") == 0 && extra > 0) {
+        ok = doArchiveAppend(arg, vector<string>(argv + first + 2, argv + argc));
+    // Listing the members of a .dna archive
+    } else if (strcmp(mode, "-t") == 0) {
+        ok = doArchiveList(arg);
+    // Extracting a single member from a .dna archive
+    } else if (strcmp(mode, "-x") == 0 && extra == 1) {
+        ok = doArchiveExtract(argv[first + 2], arg);
+    // Segmenting a file into addressed oligos, written as FASTA
+    } else if (strcmp(mode, "-s") == 0) {
+        ok = doSegmentEncode(arg);
+    // Reassembling a file from unordered FASTA/FASTQ oligo reads
+    } else if (strcmp(mode, "-j") == 0) {
+        ok = doSegmentDecode(vector<string>(argv + first + 1, argv + argc));
+    // Measuring kernel throughput
+    } else if (strcmp(mode, "-b") == 0) {
+        ok = doBenchmark(arg);
+    // Screening sequences for synthesis constraints
+    } else if (strcmp(mode, "--screen") == 0) {
+        ok = doScreen(vector<string>(argv + first + 1, argv + argc));
+    // Codon usage, stop and rare codons of the payload
+    } else if (strcmp(mode, "--codons") == 0) {
+        ok = doCodons(vector<string>(argv + first + 1, argv + argc));
+    // Searching plain payloads for a byte pattern without decoding them
+    } else if (strcmp(mode, "--grep") == 0 && extra > 0) {
+        ok = doGrep(arg, vector<string>(argv + first + 2, argv + argc));
+    // Building the FM-index sidecar of .dna files
+    } else if (strcmp(mode, "--fm-index") == 0) {
+        ok = doFmIndex(vector<string>(argv + first + 1, argv + argc));
+    // Counting and locating a nucleotide motif through the FM-index
+    } else if (strcmp(mode, "--fm-find") == 0 && extra > 0) {
+        ok = doFmFind(arg, vector<string>(argv + first + 2, argv + argc));
+    // Base counts of ranges of a .dna file through its rank sidecar
+    } else if (strcmp(mode, "--composition") == 0) {
+        ok = doComposition(arg, vector<string>(argv + first + 2, argv + argc));
+    // k-mer spectrum of .dna files and oligos
+    } else if (strcmp(mode, "--kmers") == 0 && extra > 0) {
+        ok = doKmers(arg, vector<string>(argv + first + 2, argv + argc));
+    // Too few arguments for the mode, or no such mode
+    } else {
+        printUsage(argv[0]);
+        return 1;
     }
 
-    return 0;
+    return ok ? 0 : 1;
 }
 
 bool doStringEncode(const string& message) {
 	string paddedMessage = padStringMessage(message);
     string binaryMessage = messageToBinary("STRING:" + message);
     string encoded = binaryToNucleotide(binaryMessage);
-    string finalEncoded = PROMOTER + encoded + TERMINATOR + MARKER;
+    string finalEncoded = flankSet.promoter;
+    if (codecOptions.payloadCode != plainCode) {
+        // Coded payloads are whole blocks, padded with NULs the decoder drops
+        string bytes = "STRING:" + message;
+        encodePayload(bytes + string((3 - bytes.length() % 3) % 3, '\0'), finalEncoded);
+    } else if (!codecOptions.escapeFlanks) {
+        finalEncoded += encoded;
+    } else if (!escapeFlanks(encoded.data(), encoded.length(), finalEncoded += flankSet.marker)) {
+        cerr << "The flank set cannot be escaped." << endl;
+        return false;
+    }
+    finalEncoded += flankSet.terminator + flankSet.marker;
     cout << VERSION << " || Encoded: " << finalEncoded << endl;
     return true;
 }
 
-bool doStringDecode(const string& dnaSeq) {
-	string decodedBinary = nucleotideToBinary(dnaSeq.substr(string(PROMOTER).length(), dnaSeq.length() - string(PROMOTER).length() - string(TERMINATOR).length() - string(MARKER).length()));
+bool doStringDecode(const string& encodedSeq) {
+    // A read of the reverse strand is turned around first
+    string dnaSeq = encodedSeq;
+    if (reverseStrand(dnaSeq.data(), dnaSeq.length(), flankSet.record)) {
+        reverseComplement(&dnaSeq[0], dnaSeq.length());
+    }
+    size_t start, payloadLength;
+    if (!locateFlanks(dnaSeq.data(), dnaSeq.length(), start, payloadLength)) {
+        cerr << "Could not find the PROMOTER and TERMINATOR flanks." << endl;
+        return false;
+    }
+    size_t tagLength;
+    if (taggedPayloadCode(dnaSeq.data() + start, payloadLength, tagLength) != plainCode || tagLength > 0) {
+        string decoded;
+        if (!decodePayload(dnaSeq.data() + start, payloadLength, decoded) || decoded.rfind("STRING:", 0) != 0) {
+            cerr << "Invalid coded payload." << endl;
+            return false;
+        }
+        cout << "Decoded: " << decoded.substr(7, decoded.find_last_not_of('\0') - 6) << endl;
+        return true;
+    }
+    string payload;
+    if (!escapedPayload(dnaSeq.data() + start, payloadLength)) {
+        payload = dnaSeq.substr(start, payloadLength);
+    } else if (!unescapeFlanks(dnaSeq.data() + start + flankSet.marker.length(), payloadLength - flankSet.marker.length(),
+                               payload)) {
+        cerr << "Invalid escaped payload." << endl;
+        return false;
+    }
+	string decodedBinary = nucleotideToBinary(payload);
 	string decoded = binaryToMessage(decodedBinary);
 
 	if (decoded.rfind("STRING:", 0) == 0) {
@@ -112,104 +500,437 @@ bool doStringDecode(const string& dnaSeq) {
 }
 
 bool doFileEncode(const string& fileName) {
-	ifstream inFile(fileName, ios::binary|ios::ate);
-    inFile.seekg(0, ios::beg);
-
-	string fileContents((istreambuf_iterator<char>(inFile)), istreambuf_iterator<char>());
-    streamsize fileSize = inFile.tellg();
-
-	inFile.close();
-	string header = "FILE:" + fileName + ":" + to_string(fileSize) + ":";
+    string fileContents;
+    if (!openFile(fileName, fileContents, ios::binary)) {
+        cerr << "Could not open file: " << fileName << endl;
+        return false;
+    }
 
-	string binaryFileContents = messageToBinary(header + fileContents);
-	string encoded = binaryToNucleotide(binaryFileContents);
-	string finalEncoded = PROMOTER + encoded + TERMINATOR + MARKER;
+	string finalEncoded = flankSet.promoter;
+    if (!codecOptions.escapeFlanks) {
+        encodePayload(padStringMessage(fileRecordBytes(fileName, fileContents)), finalEncoded);
+    } else if (!escapeFlanks(padStringMessage(fileRecordBytes(fileName, fileContents)), finalEncoded += flankSet.marker)) {
+        cerr << "The flank set cannot be escaped." << endl;
+        return false;
+    }
+    finalEncoded += flankSet.terminator + flankSet.marker;
 
 	ofstream outFile(fileName + ".dna", ios::binary);
 	outFile << finalEncoded;
 	outFile.close();
+    if (codecOptions.rankIndex) {
+        BaseRankBuilder rank;
+        rank.feed(finalEncoded);
+        if (!rank.write(fileName + ".dna", finalEncoded.length())) {
+            cerr << "Could not write file: " << fileName << ".dna.rank" << endl;
+            return false;
+        }
+    }
 	return true;
 }
 
+// Decodes one record's payload and writes the file it names
+static bool decodeRecordToFile(const char *dnaSeq, size_t length) {
+    string decoded, originalFileName, fileContent;
+    size_t corrected = 0;
+    if (!decodePayload(dnaSeq, length, decoded) ||
+        !decodeFileRecord(decoded, originalFileName, fileContent, &corrected)) {
+        cerr << "Invalid DNA content header or content." << endl;
+        return false;
+    }
+    if (corrected > 0) {
+        cout << "Corrected " << corrected << " symbol error(s)" << endl;
+    }
+
+    ofstream outFile(originalFileName, ios::binary);
+    if (!outFile.is_open()) {
+        cerr << "Could not create output file." << endl;
+        return false;
+    }
+
+    outFile << fileContent;
+    outFile.close();
+    cout << "Decoded to file: " << originalFileName << endl;
+    return true;
+}
+
 bool doFileDecode(const string& dnaFileName) {
     if (dnaFileName.substr(dnaFileName.find_last_of(".") + 1) != "dna") {
         cerr << "Invalid file suffix, expecting .dna file." << endl;
-        return 1;
+        return false;
     }
 
     string dnaContents;
     if (!openFile(dnaFileName, dnaContents, ios::binary)) {
         cerr << "Could not open file: " << dnaFileName << endl;
-        return 1;
+        return false;
+    }
+
+    // Remove PROMOTER, TERMINATOR, and MARKER, with any adapter bases around them, reading
+    // the file back to front if it holds the reverse strand
+    if (reverseStrand(dnaContents.data(), dnaContents.length(), flankSet.record)) {
+        reverseComplement(&dnaContents[0], dnaContents.length());
+    }
+    size_t start, payloadLength;
+    if (!locateFlanks(dnaContents.data(), dnaContents.length(), start, payloadLength)) {
+        cerr << "Invalid DNA content header or content." << endl;
+        return false;
+    }
+    if (!escapedPayload(dnaContents.data() + start, payloadLength)) {
+        return decodeRecordToFile(dnaContents.data() + start, payloadLength);
+    }
+
+    // Escaped records hold no flank, so a stream of them splits at each TERMINATOR + MARKER + PROMOTER + MARKER
+    const string &trailer = flankSet.record.trail.sequence, leader = flankSet.promoter + flankSet.marker;
+    const char *payload = dnaContents.data() + start;
+    for (size_t offset = flankSet.marker.length();;) {
+        size_t end = findFlank(payload + offset, payloadLength - offset, trailer);
+        string record;
+        if (!unescapeFlanks(payload + offset, end == string::npos ? payloadLength - offset : end, record)) {
+            cerr << "Invalid escaped payload." << endl;
+            return false;
+        }
+        if (!decodeRecordToFile(record.data(), record.length())) return false;
+        if (end == string::npos) return true;
+        offset += end + trailer.length();
+        if (payloadLength - offset < leader.length() || memcmp(payload + offset, leader.data(), leader.length()) != 0) {
+            cerr << "Invalid DNA content header or content." << endl;
+            return false;
+        }
+        offset += leader.length();
+    }
+}
+
+bool doArchiveCreate(const string& archiveName, const vector<string>& fileNames) {
+    ofstream archive(archiveName, ios::binary | ios::trunc);
+    if (!archive.is_open()) {
+        cerr << "Could not create archive: " << archiveName << endl;
+        return false;
+    }
+
+    vector<ArchiveEntry> entries;
+    uint64_t offset = flankSet.promoter.length();
+    BaseRankBuilder rank;
+    archive << flankSet.promoter;
+    if (codecOptions.rankIndex) rank.feed(flankSet.promoter);
+
+    for (const string &fileName : fileNames) {
+        string fileContents;
+        if (!openFile(fileName, fileContents, ios::binary)) {
+            cerr << "Could not open file: " << fileName << endl;
+            return false;
+        }
+        string record = encodeFileRecord(fileName, fileContents);
+        archive << record;
+        if (codecOptions.rankIndex) rank.feed(record);
+        entries.push_back(ArchiveEntry{fileName, offset, record.length()});
+        offset += record.length();
+    }
+
+    string tail = encodeArchiveTail(entries, offset);
+    archive << tail;
+    archive.close();
+    if (codecOptions.rankIndex) {
+        rank.feed(tail);
+        if (!rank.write(archiveName, offset + tail.length())) {
+            cerr << "Could not write file: " << archiveName << ".rank" << endl;
+            return false;
+        }
+    }
+    cout << "Archived " << entries.size() << " file(s) to: " << archiveName << endl;
+    return true;
+}
+
+bool doArchiveList(const string& archiveName) {
+    if (!recoverArchive(archiveName)) {
+        cerr << "Could not recover interrupted append: " << archiveName << endl;
+        return false;
+    }
+
+    ifstream archive(archiveName, ios::binary);
+    if (!archive.is_open()) {
+        cerr << "Could not open file: " << archiveName << endl;
+        return false;
     }
 
-    // Remove PROMOTER, TERMINATOR, and MARKER
-    string cleanDNA = dnaContents.substr(string(PROMOTER).length(), dnaContents.length() - string(PROMOTER).length() - string(TERMINATOR).length() - string(MARKER).length());
+    vector<ArchiveEntry> entries;
+    uint64_t indexOffset;
+    if (!readArchiveIndex(archive, entries, indexOffset)) {
+        cerr << "Invalid or missing archive index: " << archiveName << endl;
+        return false;
+    }
+
+    for (const ArchiveEntry &entry : entries) {
+        cout << entry.name << "\t" << entry.offset << "\t" << entry.length << endl;
+    }
+    return true;
+}
+
+bool doArchiveExtract(const string& archiveName, const string& memberName) {
+    if (!recoverArchive(archiveName)) {
+        cerr << "Could not recover interrupted append: " << archiveName << endl;
+        return false;
+    }
+
+    ifstream archive(archiveName, ios::binary);
+    if (!archive.is_open()) {
+        cerr << "Could not open file: " << archiveName << endl;
+        return false;
+    }
 
-    string decodedBinary = nucleotideToBinary(cleanDNA);
-    string decoded = binaryToMessage(decodedBinary);
+    vector<ArchiveEntry> entries;
+    uint64_t indexOffset;
+    if (!readArchiveIndex(archive, entries, indexOffset)) {
+        cerr << "Invalid or missing archive index: " << archiveName << endl;
+        return false;
+    }
 
-    cout << "Debug: initial decoded = " << decoded.substr(0, 50) << endl;  // First 50 characters
+    // Later entries shadow earlier ones with the same name
+    const ArchiveEntry *member = nullptr;
+    for (const ArchiveEntry &entry : entries) {
+        if (entry.name == memberName) member = &entry;
+    }
+    if (member == nullptr) {
+        cerr << "No such member in archive: " << memberName << endl;
+        return false;
+    }
 
+    // Only the member's own nucleotide range is read and decoded
+    string dnaSeq, decoded, fileName, fileContents;
+    size_t corrected = 0;
+    if (!readNucleotideRange(archive, member->offset, member->length, dnaSeq) ||
+        !nucleotideToBytes(dnaSeq.data(), dnaSeq.length(), decoded) ||
+        !decodeFileRecord(decoded, fileName, fileContents, &corrected)) {
+        cerr << "Corrupt archive member: " << memberName << endl;
+        return false;
+    }
+    if (corrected > 0) {
+        cout << "Corrected " << corrected << " symbol error(s)" << endl;
+    }
 
-    if (decoded.rfind("FILE:", 0) == 0) {
-    	size_t firstColon = decoded.find(":", 5);
-    	size_t secondColon = decoded.find(":", firstColon + 1);
-    	size_t thirdColon = decoded.find(":", secondColon + 1);
+    ofstream outFile(fileName, ios::binary);
+    if (!outFile.is_open()) {
+        cerr << "Could not create output file." << endl;
+        return false;
+    }
+    outFile << fileContents;
+    outFile.close();
+    cout << "Extracted to file: " << fileName << endl;
+    return true;
+}
 
-    	cout << "Debug: firstColon = " << firstColon << ", secondColon = " << secondColon << endl;
+bool doArchiveAppend(const string& archiveName, const vector<string>& fileNames) {
+    if (access(archiveName.c_str(), F_OK) != 0) return doArchiveCreate(archiveName, fileNames);
 
-    	string originalFileName = decoded.substr(5, firstColon - 5);
+    if (!recoverArchive(archiveName)) {
+        cerr << "Could not recover interrupted append: " << archiveName << endl;
+        return false;
+    }
 
-    	cout << "Debug: originalFileName = " << originalFileName << endl;
+    ifstream archive(archiveName, ios::binary);
+    vector<ArchiveEntry> entries;
+    uint64_t indexOffset;
+    if (!archive.is_open() || !readArchiveIndex(archive, entries, indexOffset)) {
+        cerr << "Invalid or missing archive index: " << archiveName << endl;
+        return false;
+    }
 
-    	string fileSizeStr = decoded.substr(firstColon + 1, secondColon - firstColon - 1);
+    archive.seekg(0, ios::end);
+    uint64_t archiveLength = archive.tellg();
+    string oldTail;
+    if (!readNucleotideRange(archive, indexOffset, archiveLength - indexOffset, oldTail)) {
+        cerr << "Could not read archive index: " << archiveName << endl;
+        return false;
+    }
+    archive.close();
 
-    	cout << "Debug: fileSizeStr = " << fileSizeStr << endl;
+    // New records go where the old index starts
+    string records;
+    uint64_t offset = indexOffset;
+    for (const string &fileName : fileNames) {
+        string fileContents;
+        if (!openFile(fileName, fileContents, ios::binary)) {
+            cerr << "Could not open file: " << fileName << endl;
+            return false;
+        }
+        string record = encodeFileRecord(fileName, fileContents);
+        records += record;
+        entries.push_back(ArchiveEntry{fileName, offset, record.length()});
+        offset += record.length();
+    }
+    string newTail = encodeArchiveTail(entries, offset);
 
-    	string fileContent = decoded.substr(thirdColon + 1);
+    // Write-ahead: the journal holds both tails before the archive is touched, so an
+    // interrupted append either completes or rolls back to the old index on next open
+    string journalName = archiveName + ".journal";
+    string journal = "JOURNAL:" + to_string(indexOffset) + ":" + to_string(oldTail.length()) + ":" +
+                     to_string(newTail.length()) + ":" + to_string(offset + newTail.length()) + "\n" +
+                     oldTail + newTail;
+    if (!writeFileDurably(journalName, journal, O_CREAT | O_TRUNC)) {
+        cerr << "Could not write journal: " << journalName << endl;
+        return false;
+    }
 
-    	//cout << "Debug: decoded = " << decoded << endl;
+    if (!writeFileDurably(archiveName, records + newTail, 0, indexOffset)) {
+        cerr << "Append interrupted, rolling back: " << archiveName << endl;
+        recoverArchive(archiveName);
+        return false;
+    }
+    unlink(journalName.c_str());
+    if (codecOptions.rankIndex && !writeRankIndex(archiveName)) {
+        cerr << "Could not write file: " << archiveName << ".rank" << endl;
+        return false;
+    }
 
-    	if (originalFileName.empty() || fileContent.empty()) {
-    		cerr << "Invalid DNA content header or content." << endl;
-    		return 1;
-    	}
+    cout << "Appended " << fileNames.size() << " file(s) to: " << archiveName << endl;
+    return true;
+}
 
-    	// Parse the file size from the header
-    	size_t originalFileSize = 0;
-    	try {
-    	    if (!fileSizeStr.empty() && fileSizeStr.find_first_not_of("0123456789") == string::npos) {
-    	        originalFileSize = stoi(fileSizeStr);
-    	    } else {
-    	        cerr << "Invalid or empty file size in header." << endl;
-    	        return 1;
-    	    }
-    	} catch (const invalid_argument& e) {
-    	    cerr << "Invalid file size in header: " << e.what() << endl;
-    	    return 1;
-    	} catch (const exception& e) {
-    	    cerr << "An exception occurred: " << e.what() << endl;
-    	    return 1;
-    	}
+bool doSegmentEncode(const string& fileName) {
+    string fileContents;
+    if (!openFile(fileName, fileContents, ios::binary)) {
+        cerr << "Could not open file: " << fileName << endl;
+        return false;
+    }
 
-    	// Remove padding
-    	fileContent = fileContent.substr(0, originalFileSize);
+    OligoLayout layout = oligoLayoutFor(codecOptions);
+    if (layout.stripeLength <= (layout.fountain ? 4u : 0u)) {     // droplet stripes start with 4 bytes of K
+        cerr << "The flanks leave no room for a stripe, use a longer --oligo-length." << endl;
+        return false;
+    }
+    string record = fileRecordBytes(fileName, fileContents);
+    string stripes;
+    vector<uint32_t> seeds;
+    if (!layout.fountain) {
+        stripes = segmentRecord(record, layout);
+    } else if (!fountainEncode(record, layout, codecOptions, stripes, seeds)) {
+        cerr << "Too few droplets pass --max-run and --gc-min/--gc-max, relax them or use other flanks." << endl;
+        return false;
+    }
+    size_t count = stripes.length() / layout.stripeLength;
+    if (count > UINT32_MAX) {
+        cerr << "Too many oligos for a 32-bit index, use a longer --oligo-length." << endl;
+        return false;
+    }
 
+    ofstream outFile(fileName + ".fasta", ios::binary);
+    if (!outFile.is_open() || !writeOligoFasta(outFile, stripes, layout, layout.fountain ? &seeds : nullptr)) {
+        cerr << "Could not write output file: " << fileName << ".fasta" << endl;
+        return false;
+    }
+    outFile.close();
+    if (layout.fountain) {
+        cout << "Segmented " << count << " droplets of " << oligoSequenceLength(layout) << " nt from "
+             << seeds.back() + 1 << " seeds to: " << fileName << ".fasta" << endl;
+    } else {
+        cout << "Segmented " << count << " oligos of " << oligoSequenceLength(layout) << " nt to: " << fileName << ".fasta" << endl;
+    }
+    return true;
+}
 
-    	ofstream outFile(originalFileName, ios::binary);
-    	if (!outFile.is_open()) {
-    		cerr << "Could not create output file." << endl;
-    		return 1;
-    	}
+bool doSegmentDecode(const vector<string>& readFiles) {
+    OligoLayout layout;
+    string stripes;
+    vector<bool> present;
+    vector<size_t> erasures;
+    OligoReadStats stats;
+    if (!collectOligos(readFiles, layout, stripes, present, erasures, stats)) return false;
 
-    	outFile << fileContent;
-    	outFile.close();
-    	cout << "Decoded to file: " << originalFileName << endl;
+    vector<size_t> missing;
+    for (size_t i = 0; i < present.size(); ++i) {
+        if (!present[i]) missing.push_back(i);
+    }
+    cout << "Read " << stats.reads << " oligos: " << stats.unique - stats.consensus << " unique, "
+         << stats.reads - stats.invalid - stats.damaged - (stats.unique - stats.consensus) << " duplicate, "
+         << stats.damaged << " damaged (" << stats.shifted << " with indels), " << stats.invalid << " invalid" << endl;
+    if (stats.reversed > 0) cout << "Turned around " << stats.reversed << " read(s) of the reverse strand" << endl;
+    if (stats.clustered > 0) cout << "Regrouped " << stats.clustered << " damaged read(s) with a damaged index by content" << endl;
+    if (stats.consensus > 0) cout << "Recovered " << stats.consensus << " oligo(s) by consensus of damaged reads" << endl;
+    if (stats.unverified > 0) {
+        cout << "Placed " << stats.unverified << " unverified oligo(s) as erasures for the outer code" << endl;
+    }
+    string record;
+    if (layout.fountain) {
+        // Seeds that failed the screen were never written, so gaps in the indices are expected
+        FountainStats fountain;
+        if (!fountainDecode(stripes, present, layout.stripeLength, record, erasures, fountain)) {
+            cerr << "No verified droplets to decode." << endl;
+            return false;
+        }
+        cout << "Peeled " << fountain.peeled << " of " << fountain.segments << " segments from " << fountain.droplets
+             << " droplets" << endl;
+        if (fountain.eliminated > 0) cout << "Solved " << fountain.eliminated << " segment(s) by elimination" << endl;
+        size_t unsolved = fountain.segments - fountain.peeled - fountain.eliminated;
+        if (unsolved > 0) cout << "Passing " << unsolved << " unsolved segment(s) to the outer code as erasures" << endl;
     } else {
-    	cerr << "Invalid DNA content header." << endl;
-    	return 1;
+        if (!missing.empty()) {
+            cout << "Missing " << missing.size() << " oligo(s): " << formatIndexRanges(missing, 20) << endl;
+        }
+
+        size_t rebuilt = 0;
+        if (layout.parityStripes > 0 && !missing.empty()) {
+            ErasureCode code = makeErasureCode(layout.groupStripes, layout.parityStripes);
+            bool complete = erasureRebuildStripes(stripes, present, layout.stripeLength, code, rebuilt);
+            if (rebuilt > 0) cout << "Rebuilt " << rebuilt << " oligos from parity" << endl;
+            if (!complete) {
+                // Data stripes of the groups parity could not rebuild become erasures at their place in the record
+                const size_t stride = layout.groupStripes + layout.parityStripes;
+                size_t passed = 0;
+                for (size_t i = 0; i < present.size(); ++i) {
+                    size_t first = i / stride * stride;
+                    size_t groupData = min(stride, present.size() - first) - layout.parityStripes;
+                    if (present[i] || i - first >= groupData) continue;
+                    size_t position = (first / stride * layout.groupStripes + i - first) * layout.stripeLength;
+                    for (size_t b = 0; b < layout.stripeLength; ++b) erasures.push_back(position + b);
+                    ++passed;
+                }
+                cout << "Passing " << passed << " oligo(s) parity could not rebuild to the outer code as erasures" << endl;
+            }
+        } else if (!missing.empty()) {
+            // Without oligo parity a missing stripe is a run of erasures for the outer code
+            for (size_t i : missing) {
+                for (size_t b = 0; b < layout.stripeLength; ++b) erasures.push_back(i * layout.stripeLength + b);
+            }
+            cout << "Passing " << missing.size() << " missing oligo(s) to the outer code as erasures" << endl;
+        }
+
+        // Drop the parity stripes to get the record back
+        if (layout.parityStripes == 0) {
+            record.swap(stripes);
+        } else {
+            size_t groupBytes = layout.groupStripes * layout.stripeLength;
+            size_t stride = (layout.groupStripes + layout.parityStripes) * layout.stripeLength;
+            for (size_t offset = 0; offset < stripes.length(); offset += stride) record.append(stripes, offset, groupBytes);
+        }
+    }
+
+    string fileName, fileContents;
+    size_t corrected = 0;
+    if (!decodeFileRecord(record, fileName, fileContents, &corrected, erasures)) {
+        if (layout.fountain && !erasures.empty()) {
+            cerr << "Unsolved segments could not be corrected; they need more droplets or the --rs outer code with enough parity." << endl;
+        } else if (layout.fountain) {
+            cerr << "The solved segments do not form a valid file record." << endl;
+        } else if (!erasures.empty()) {
+            cerr << "Missing or unverified oligos could not be corrected; they need the --rs outer code with enough parity, "
+                    "and the record header in verified oligos." << endl;
+        } else {
+            cerr << "Invalid or truncated file record, oligos may be missing after index " << present.size() - 1 << "." << endl;
+        }
+        return false;
+    }
+    if (corrected > 0) {
+        cout << "Corrected " << corrected << " symbol error(s)" << endl;
+    }
+
+    ofstream outFile(fileName, ios::binary);
+    if (!outFile.is_open()) {
+        cerr << "Could not create output file." << endl;
+        return false;
     }
+    outFile << fileContents;
+    outFile.close();
+    cout << "Decoded to file: " << fileName << endl;
     return true;
 }
 
@@ -293,3 +1014,6090 @@ string padBinaryFileContent(const string &fileContent ) {
 	}
 	return paddedFileContent;
 }
+
+
+/*
+    Fast byte-level codec.
+
+    Each byte maps to a fixed 4-nucleotide word, most significant bit pair first, exactly
+    as binaryToNucleotide(messageToBinary(...)) does, but through lookup tables instead of
+    intermediate strings of '0' and '1'.
+*/
+
+static const char nucleotideSymbols[4] = {'A', 'C', 'G', 'T'};
+
+struct NucleotideTables {
+    unsigned char codes[256];   // 0-3 for A/C/G/T, 0xFF for anything else
+    char words[256][4];         // 4-nucleotide word of each byte
+
+    NucleotideTables() {
+        memset(codes, 0xFF, sizeof(codes));
+        for (int i = 0; i < 4; ++i) codes[(unsigned char)nucleotideSymbols[i]] = i;
+        for (int b = 0; b < 256; ++b) {
+            for (int j = 0; j < 4; ++j) words[b][j] = nucleotideSymbols[(b >> (6 - 2 * j)) & 3];
+        }
+    }
+};
+
+static const NucleotideTables &nucleotideTables() {
+    static const NucleotideTables tables;
+    return tables;
+}
+
+static const unsigned char *nucleotideCodes() {
+    return nucleotideTables().codes;
+}
+
+// Convert bytes to DNA sequence
+string bytesToNucleotide(const string &bytes) {
+    string dnaSeq(bytes.length() * 4, 'A');
+    bytesToNucleotide((const unsigned char *)bytes.data(), bytes.length(), &dnaSeq[0]);
+    return dnaSeq;
+}
+
+void bytesToNucleotide(const unsigned char *bytes, size_t length, char *dnaSeq) {
+    const NucleotideTables &tables = nucleotideTables();
+    for (size_t i = 0; i < length; ++i) memcpy(dnaSeq + 4 * i, tables.words[bytes[i]], 4);
+}
+
+// Convert DNA sequence to bytes, failing on a partial word or a non-ACGT symbol
+bool nucleotideToBytes(const char *dnaSeq, size_t length, string &bytes) {
+    if (length % 4 != 0) return false;
+    bytes.resize(length / 4);
+    return nucleotideToBytes(dnaSeq, length, (unsigned char *)&bytes[0]);
+}
+
+bool nucleotideToBytes(const char *dnaSeq, size_t length, unsigned char *bytes) {
+    if (length % 4 != 0) return false;
+
+    const unsigned char *codes = nucleotideCodes();
+    unsigned char invalid = 0;
+    for (size_t i = 0, j = 0; i < length; i += 4, ++j) {
+        unsigned char c0 = codes[(unsigned char)dnaSeq[i]];
+        unsigned char c1 = codes[(unsigned char)dnaSeq[i + 1]];
+        unsigned char c2 = codes[(unsigned char)dnaSeq[i + 2]];
+        unsigned char c3 = codes[(unsigned char)dnaSeq[i + 3]];
+        invalid |= c0 | c1 | c2 | c3;
+        bytes[j] = (unsigned char)((c0 << 6) | (c1 << 4) | (c2 << 2) | c3);
+    }
+    return (invalid & 0xFC) == 0;
+}
+
+/*
+    Flank search.
+
+    Reads come back with adapter bases before the PROMOTER and after the MARKER, and with
+    substitutions and indels inside the flanks themselves, so the flanks are located rather
+    than assumed. An exact match at both ends costs two compares; anything else is searched
+    with Myers' bit-vector algorithm, one 64-bit word per flank, over a window of
+    flankSearchWindow nucleotides at each end. The leading flank is scanned forwards and the
+    trailing one backwards over the reversed text. Each search takes the lowest edit distance
+    within flankErrors, and on a tie the occurrence nearest the unpadded position.
+
+    The built-in flanks can be replaced per run with --flanks <file> or --promoter,
+    --terminator and --marker, for vendors and hosts that need other sequences. The match
+    masks of the active set, forwards, backwards and on the reverse strand, are built once
+    while the options are parsed. A record written with another set carries its FNV-1a hash
+    as flanks=<id> in its XFILE header.
+*/
+
+static const size_t flankSearchWindow = 256;    // adapter bases tolerated at each end, plus the flank
+static const size_t flankErrors = 2;            // edits tolerated in each flank
+
+// One column step of Myers' algorithm over a 64-row word; returns the horizontal delta out of its last row
+// and leaves every row's horizontal delta in ph, mh
+static inline int myersStep(uint64_t &pv, uint64_t &mv, uint64_t eq, int hin, uint64_t lastRow, uint64_t &ph, uint64_t &mh) {
+    uint64_t xv = eq | mv;
+    if (hin < 0) eq |= 1;
+    uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+    ph = mv | ~(xh | pv);
+    mh = pv & xh;
+    int hout = (ph & lastRow ? 1 : 0) - (mh & lastRow ? 1 : 0);
+    uint64_t pho = ph, mho = mh;
+    pho <<= 1;
+    mho <<= 1;
+    if (hin < 0) mho |= 1;
+    else if (hin > 0) pho |= 1;
+    pv = mho | ~(xv | pho);
+    mv = pho & xv;
+    return hout;
+}
+
+static void flankMasks(const string &sequence, bool backwards, uint64_t peq[4]) {
+    const unsigned char *codes = nucleotideCodes();
+    const size_t length = sequence.length();
+    peq[0] = peq[1] = peq[2] = peq[3] = 0;
+    for (size_t i = 0; i < length; ++i) {
+        peq[codes[(unsigned char)sequence[backwards ? length - 1 - i : i]] & 3] |= uint64_t(1) << i;
+    }
+}
+
+static FlankPattern compileFlank(const string &sequence) {
+    FlankPattern pattern;
+    pattern.sequence = sequence;
+    flankMasks(sequence, false, pattern.peq);
+    flankMasks(sequence, true, pattern.tailPeq);
+    return pattern;
+}
+
+static FlankPair compileFlankPair(const string &lead, const string &trail) {
+    FlankPair pair;
+    pair.lead = compileFlank(lead);
+    pair.trail = compileFlank(trail);
+    pair.reverseLead = compileFlank(reverseComplementOf(trail));
+    pair.reverseTrail = compileFlank(reverseComplementOf(lead));
+    return pair;
+}
+
+static bool validFlank(const string &sequence) {
+    return sequence.length() >= 4 && sequence.length() <= 32 && sequence.find_first_not_of("ACGT") == string::npos;
+}
+
+// Matchers for a flank set. A set whose flanks read the same on both strands is refused,
+// since the strand of a read could not be told from them.
+bool compileFlankSet(const string &promoter, const string &terminator, const string &marker, FlankSet &flanks) {
+    if (!validFlank(promoter) || !validFlank(terminator) || !validFlank(marker)) {
+        cerr << "Flanks must be 4-32 nt of A, C, G and T." << endl;
+        return false;
+    }
+    if (promoter == reverseComplementOf(terminator) || promoter == reverseComplementOf(terminator + marker)) {
+        cerr << "The PROMOTER must not be the reverse complement of the TERMINATOR or TERMINATOR + MARKER." << endl;
+        return false;
+    }
+    // Coded payloads start with the TERMINATOR, which plain and escaped ones must not
+    const string headers[] = {bytesToNucleotide(string("STRING:")), bytesToNucleotide(string("XFILE:")),
+                              bytesToNucleotide(string("FILE:"))};
+    for (const string &start : {headers[0], headers[1], headers[2], marker}) {
+        if (start.compare(0, terminator.length(), terminator) == 0) {
+            cerr << "The TERMINATOR must not begin the MARKER or a record header." << endl;
+            return false;
+        }
+    }
+    // Escaped payloads start with the MARKER, which plain ones must not; a MARKER longer than a
+    // header would depend on what follows it, so any overlap is refused
+    for (const string &header : headers) {
+        if (header.compare(0, marker.length(), marker, 0, header.length()) == 0) {
+            cerr << "The MARKER must not begin a record header." << endl;
+            return false;
+        }
+    }
+    flanks.promoter = promoter;
+    flanks.terminator = terminator;
+    flanks.marker = marker;
+    flanks.record = compileFlankPair(promoter, terminator + marker);
+    flanks.oligo = compileFlankPair(promoter, terminator);
+
+    const unsigned char *codes = nucleotideCodes();
+    const string *escaped[3] = {&promoter, &terminator, &marker};
+    FlankEscape &escape = flanks.escape;
+    escape.count = 3;
+    for (size_t m = 0; m < escape.count; ++m) {
+        const string &flank = *escaped[m];
+        size_t prefixLength = flank.length() - 1;
+        escape.prefix[m] = 0;
+        for (size_t i = 0; i < prefixLength; ++i) escape.prefix[m] = escape.prefix[m] << 2 | codes[(unsigned char)flank[i]];
+        escape.mask[m] = (uint64_t(1) << (2 * prefixLength)) - 1;
+        escape.last[m] = codes[(unsigned char)flank[prefixLength]];
+        escape.prefixLength[m] = prefixLength;
+        memcpy(escape.prefixText[m], flank.data(), prefixLength);
+        for (size_t j = 0; j < 4; ++j) escape.anchor[m][j] = j + prefixLength >= 4 ? flank[j + prefixLength - 4] : 0;
+    }
+
+    // FNV-1a, never 0 for a set other than the built-in one
+    flanks.id = 0;
+    if (promoter != PROMOTER || terminator != TERMINATOR || marker != MARKER) {
+        uint32_t hash = 2166136261u;
+        for (unsigned char c : promoter + ":" + terminator + ":" + marker) hash = (hash ^ c) * 16777619u;
+        flanks.id = hash == 0 ? 1 : hash;
+    }
+    return true;
+}
+
+// "key = value" lines for promoter, terminator and marker; '#' starts a comment, unset keys keep their value
+bool readFlankConfig(const string &fileName, string &promoter, string &terminator, string &marker) {
+    string contents;
+    if (!openFile(fileName, contents, ios::in)) {
+        cerr << "Could not open flank set: " << fileName << endl;
+        return false;
+    }
+    istringstream lines(contents);
+    string line;
+    for (size_t number = 1; getline(lines, line); ++number) {
+        line = line.substr(0, line.find('#'));
+        size_t equals = line.find('=');
+        string key = line.substr(0, equals), value = equals == string::npos ? "" : line.substr(equals + 1);
+        key.erase(remove_if(key.begin(), key.end(), ::isspace), key.end());
+        value.erase(remove_if(value.begin(), value.end(), ::isspace), value.end());
+        transform(value.begin(), value.end(), value.begin(), ::toupper);
+        if (key.empty() && equals == string::npos) continue;
+        if (key == "promoter") {
+            promoter = value;
+        } else if (key == "terminator") {
+            terminator = value;
+        } else if (key == "marker") {
+            marker = value;
+        } else {
+            cerr << fileName << ":" << number << ": expecting promoter, terminator or marker = <nt>" << endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// End of the best approximate occurrence of a pattern of at most 64 nt, given its match masks, npos if
+// none within maxErrors; ties go to the end nearest expected. Its edit distance goes to distance,
+// maxErrors + 1 if none.
+static size_t approximateEnd(const char *text, size_t length, const uint64_t peq[4], size_t patternLength,
+                             size_t maxErrors, size_t expected, size_t *distance = nullptr) {
+    const unsigned char *codes = nucleotideCodes();
+    uint64_t pv = ~uint64_t(0), mv = 0, ph, mh, lastRow = uint64_t(1) << (patternLength - 1);
+    size_t score = patternLength, best = string::npos, bestScore = maxErrors + 1;
+    for (size_t j = 0; j < length; ++j) {
+        unsigned char code = codes[(unsigned char)text[j]];
+        score += myersStep(pv, mv, code < 4 ? peq[code] : 0, 0, lastRow, ph, mh);
+        size_t offset = j + 1 > expected ? j + 1 - expected : expected - j - 1;
+        if (score > maxErrors) continue;
+        if (score < bestScore || (score == bestScore && offset < (best > expected ? best - expected : expected - best))) {
+            bestScore = score;
+            best = j + 1;
+        }
+        if (bestScore == 0 && j + 1 >= expected) break;     // nothing later can be closer
+    }
+    if (distance != nullptr) *distance = bestScore;
+    return best;
+}
+
+static size_t approximateEnd(const char *text, size_t length, const FlankPattern &pattern, size_t maxErrors,
+                             size_t *distance = nullptr) {
+    return approximateEnd(text, min(length, flankSearchWindow), pattern.peq, pattern.sequence.length(), maxErrors,
+                          pattern.sequence.length(), distance);
+}
+
+// Offset of the best approximate occurrence of a pattern ending the text, npos if none within maxErrors
+static size_t approximateStart(const char *text, size_t length, const FlankPattern &pattern, size_t maxErrors,
+                               size_t *distance = nullptr) {
+    char tail[flankSearchWindow];
+    size_t window = min(length, flankSearchWindow), patternLength = pattern.sequence.length();
+    for (size_t i = 0; i < window; ++i) tail[i] = text[length - 1 - i];
+    size_t trimmed = approximateEnd(tail, window, pattern.tailPeq, patternLength, maxErrors, patternLength, distance);
+    return trimmed == string::npos ? string::npos : length - trimmed;
+}
+
+bool locateFlanks(const char *dnaSeq, size_t length, size_t &start, size_t &payloadLength) {
+    const string &promoter = flankSet.record.lead.sequence, &trailer = flankSet.record.trail.sequence;
+    if (length >= promoter.length() + trailer.length() && memcmp(dnaSeq, promoter.data(), promoter.length()) == 0 &&
+        memcmp(dnaSeq + length - trailer.length(), trailer.data(), trailer.length()) == 0) {
+        start = promoter.length();
+        payloadLength = length - promoter.length() - trailer.length();
+        return true;
+    }
+
+    start = approximateEnd(dnaSeq, length, flankSet.record.lead, flankErrors);
+    if (start == string::npos) return false;
+    payloadLength = approximateStart(dnaSeq + start, length - start, flankSet.record.trail, flankErrors);
+    return payloadLength != string::npos;
+}
+
+/*
+    Multi-file archives.
+
+    An archive keeps the single-file framing, one PROMOTER at the start and one
+    TERMINATOR + MARKER at the end, with everything in between in codon-padded records:
+
+        PROMOTER | FILE record ... | INDEX record | TOC trailer | TERMINATOR | MARKER
+
+    Each FILE record is the same "FILE:<name>:<size>:<contents>" payload written by -i.
+    The INDEX record lists "<name>:<offset>:<length>" per member, in nucleotides from the
+    start of the archive. The TOC trailer is a fixed-width "TOC:" + 16 hex digits of index
+    offset + 16 hex digits of index length, so a reader can seek straight to it from the
+    end of the file and then read only the member it needs.
+*/
+
+static const size_t tocBytes = 36;  // "TOC:" + 16 + 16 hex digits, a multiple of 3
+
+// Plain members are written as legacy FILE records so older readers still decode them.
+// Encoding options produce "XFILE:<name>:<size>:<options>:<body>", where <options> lists
+// the transforms applied to the contents, e.g. "rs=16".
+string encodeFileRecord(const string &fileName, const string &fileContents) {
+    return bytesToNucleotide(padStringMessage(fileRecordBytes(fileName, fileContents)));
+}
+
+// Record before codon padding and nucleotide mapping
+string fileRecordBytes(const string &fileName, const string &fileContents) {
+    if (codecOptions.rsParity == 0 && codecOptions.flanks == 0 && codecOptions.whitenSeed == 0) {
+        return "FILE:" + fileName + ":" + to_string(fileContents.length()) + ":" + fileContents;
+    }
+    string header = "XFILE:" + fileName + ":" + to_string(fileContents.length()) + ":" + formatRecordOptions(codecOptions) + ":";
+    string record = header + (codecOptions.rsParity > 0 ? rsEncode(fileContents, codecOptions.rsParity) : fileContents);
+    // Parity is whitened with the data, so the whole body is balanced and a base error stays one byte error
+    if (codecOptions.whitenSeed > 0) {
+        whitenBytes(&record[header.length()], record.length() - header.length(), (uint32_t)codecOptions.whitenSeed);
+    }
+    return record;
+}
+
+// A size or offset field; false if it is empty, not decimal or too long to fit 64 bits
+static bool parseDecimal(const string &text, uint64_t &value) {
+    if (text.empty() || text.length() > 19 || text.find_first_not_of("0123456789") != string::npos) return false;
+    value = stoull(text);
+    return true;
+}
+
+bool decodeFileRecord(const string &decoded, string &fileName, string &fileContents, size_t *corrected,
+                      const vector<size_t> &erasures) {
+    bool extended = decoded.rfind("XFILE:", 0) == 0;
+    if (!extended && decoded.rfind("FILE:", 0) != 0) return false;
+
+    size_t nameStart = extended ? 6 : 5;
+    size_t firstColon = decoded.find(':', nameStart);
+    size_t secondColon = firstColon == string::npos ? string::npos : decoded.find(':', firstColon + 1);
+    if (secondColon == string::npos) return false;
+
+    uint64_t fileSize;
+    if (!parseDecimal(decoded.substr(firstColon + 1, secondColon - firstColon - 1), fileSize) ||
+        fileSize > decoded.length()) {
+        return false;
+    }
+
+    fileName = decoded.substr(nameStart, firstColon - nameStart);
+    if (fileName.empty()) return false;
+
+    // Bytes flagged as unreliable are only trusted under the outer code
+    if (!extended) {
+        if (!erasures.empty() || fileSize > decoded.length() - secondColon - 1) return false;
+        fileContents = decoded.substr(secondColon + 1, fileSize);
+        return true;
+    }
+
+    size_t thirdColon = decoded.find(':', secondColon + 1);
+    CodecOptions options;
+    // The header has no outer code of its own, so it must hold no erasure
+    for (size_t position : erasures) {
+        if (thirdColon == string::npos || position <= thirdColon) return false;
+    }
+    if (thirdColon == string::npos ||
+        !parseRecordOptions(decoded.substr(secondColon + 1, thirdColon - secondColon - 1), options)) {
+        return false;
+    }
+    // The flanks were found before the header could be read, so a different set is only reported
+    if (options.flanks != codecOptions.flanks) {
+        cerr << "Record " << fileName << " was written with flank set " << options.flanks
+             << ", decoding with flank set " << codecOptions.flanks << endl;
+    }
+
+    size_t bodyLength = options.rsParity > 0 ? rsEncodedLength(fileSize, options.rsParity) : fileSize;
+    if (bodyLength > decoded.length() - thirdColon - 1 || (!erasures.empty() && options.rsParity == 0)) return false;
+    string body = decoded.substr(thirdColon + 1, bodyLength);
+    if (options.whitenSeed > 0) whitenBytes(&body[0], body.length(), (uint32_t)options.whitenSeed);
+
+    vector<size_t> bodyErasures;
+    for (size_t position : erasures) {
+        if (position > thirdColon && position - thirdColon - 1 < bodyLength) bodyErasures.push_back(position - thirdColon - 1);
+    }
+
+    size_t fixed = 0;
+    if (options.rsParity > 0 && !rsDecode(body, options.rsParity, body, fixed, bodyErasures)) return false;
+    if (corrected != nullptr) *corrected += fixed;
+
+    body.resize(fileSize);
+    fileContents.swap(body);
+    return true;
+}
+
+// INDEX record, TOC trailer and closing flanks that end every archive
+string encodeArchiveTail(const vector<ArchiveEntry> &entries, uint64_t indexOffset) {
+    string index = "INDEX:";
+    for (const ArchiveEntry &entry : entries) {
+        index += entry.name + ":" + to_string(entry.offset) + ":" + to_string(entry.length) + "\n";
+    }
+    string indexDNA = bytesToNucleotide(padStringMessage(index));
+
+    char toc[tocBytes + 1];
+    snprintf(toc, sizeof(toc), "TOC:%016llx%016llx",
+             (unsigned long long)indexOffset, (unsigned long long)indexDNA.length());
+
+    return indexDNA + bytesToNucleotide(string(toc, tocBytes)) + flankSet.terminator + flankSet.marker;
+}
+
+bool readNucleotideRange(ifstream &archive, uint64_t offset, uint64_t length, string &dnaSeq) {
+    dnaSeq.resize(length);
+    archive.clear();
+    archive.seekg(offset, ios::beg);
+    return length == 0 || (archive.read(&dnaSeq[0], length) && (uint64_t)archive.gcount() == length);
+}
+
+bool readArchiveIndex(ifstream &archive, vector<ArchiveEntry> &entries, uint64_t &indexOffset) {
+    const string &trailer = flankSet.record.trail.sequence;
+    const uint64_t flankLength = trailer.length();
+    const uint64_t tocLength = tocBytes * 4;
+
+    archive.clear();
+    archive.seekg(0, ios::end);
+    uint64_t archiveLength = archive.tellg();
+    if (archiveLength < flankSet.promoter.length() + tocLength + flankLength) return false;
+
+    string tail, toc;
+    if (!readNucleotideRange(archive, archiveLength - tocLength - flankLength, tocLength + flankLength, tail) ||
+        tail.compare(tocLength, flankLength, trailer) != 0 ||
+        !nucleotideToBytes(tail.data(), tocLength, toc) || toc.compare(0, 4, "TOC:") != 0) {
+        return false;
+    }
+
+    uint64_t indexLength = 0;
+    for (size_t i = 4; i < tocBytes; ++i) {
+        if (!isxdigit((unsigned char)toc[i])) return false;
+    }
+    indexOffset = stoull(toc.substr(4, 16), nullptr, 16);
+    indexLength = stoull(toc.substr(20, 16), nullptr, 16);
+    const uint64_t indexEnd = archiveLength - tocLength - flankLength;
+    if (indexOffset > indexEnd || indexLength != indexEnd - indexOffset) return false;
+
+    string indexDNA, index;
+    if (!readNucleotideRange(archive, indexOffset, indexLength, indexDNA) ||
+        !nucleotideToBytes(indexDNA.data(), indexLength, index) || index.compare(0, 6, "INDEX:") != 0) {
+        return false;
+    }
+
+    entries.clear();
+    size_t lineStart = 6;
+    for (size_t lineEnd; (lineEnd = index.find('\n', lineStart)) != string::npos; lineStart = lineEnd + 1) {
+        string line = index.substr(lineStart, lineEnd - lineStart);
+        size_t lengthColon = line.rfind(':');
+        size_t offsetColon = lengthColon == string::npos || lengthColon == 0 ? string::npos : line.rfind(':', lengthColon - 1);
+        if (offsetColon == string::npos) return false;
+
+        ArchiveEntry entry;
+        entry.name = line.substr(0, offsetColon);
+        if (!parseDecimal(line.substr(offsetColon + 1, lengthColon - offsetColon - 1), entry.offset) ||
+            !parseDecimal(line.substr(lengthColon + 1), entry.length) ||
+            entry.offset > indexOffset || entry.length > indexOffset - entry.offset) {
+            return false;
+        }
+        entries.push_back(entry);
+    }
+    return true;
+}
+
+// Write data at offset, cut the file there and fsync it before returning
+bool writeFileDurably(const string &fileName, const string &data, int flags, uint64_t offset) {
+    int fd = open(fileName.c_str(), O_WRONLY | flags, 0644);
+    if (fd < 0) return false;
+
+    bool ok = true;
+    for (size_t written = 0; ok && written < data.length(); ) {
+        ssize_t n = pwrite(fd, data.data() + written, data.length() - written, offset + written);
+        if (n <= 0) ok = false;
+        else written += n;
+    }
+    ok = ok && ftruncate(fd, offset + data.length()) == 0 && fsync(fd) == 0;
+    ok = close(fd) == 0 && ok;
+
+    // Make a newly created file's directory entry durable as well
+    if (ok && (flags & O_CREAT)) {
+        size_t slash = fileName.find_last_of('/');
+        string dirName = slash == string::npos ? "." : fileName.substr(0, slash + 1);
+        int dirFd = open(dirName.c_str(), O_RDONLY);
+        if (dirFd >= 0) {
+            fsync(dirFd);
+            close(dirFd);
+        }
+    }
+    return ok;
+}
+
+// Finish or roll back an append that was interrupted after its journal was written
+bool recoverArchive(const string &archiveName) {
+    string journalName = archiveName + ".journal";
+    string journal;
+    if (!openFile(journalName, journal, ios::binary)) return true;
+
+    unsigned long long indexOffset, oldLength, newLength, finalLength;
+    size_t headerEnd = journal.find('\n');
+    if (headerEnd == string::npos ||
+        sscanf(journal.c_str(), "JOURNAL:%llu:%llu:%llu:%llu", &indexOffset, &oldLength, &newLength, &finalLength) != 4 ||
+        journal.length() != headerEnd + 1 + oldLength + newLength) {
+        // The journal itself never became durable, so the archive was not touched
+        return unlink(journalName.c_str()) == 0;
+    }
+    string oldTail = journal.substr(headerEnd + 1, oldLength);
+    string newTail = journal.substr(headerEnd + 1 + oldLength, newLength);
+
+    ifstream archive(archiveName, ios::binary);
+    if (!archive.is_open()) return false;
+    archive.seekg(0, ios::end);
+    uint64_t archiveLength = archive.tellg();
+
+    string tail;
+    bool complete = archiveLength == finalLength &&
+                    readNucleotideRange(archive, finalLength - newLength, newLength, tail) && tail == newTail;
+    archive.close();
+
+    if (!complete && !writeFileDurably(archiveName, oldTail, 0, indexOffset)) return false;
+    return unlink(journalName.c_str()) == 0;
+}
+
+/*
+    Encoding options.
+
+    Options precede the mode on the command line and are written into the header of each
+    XFILE record as comma-separated key=value pairs, so decoding needs no options at all.
+*/
+
+static bool parseIntOption(const char *value, int low, int high, int &option) {
+    if (*value == '\0' || strspn(value, "0123456789") != strlen(value)) return false;
+    option = atoi(value);
+    return option >= low && option <= high;
+}
+
+// Also compiles the flank set for the rest of the run, so flank search costs the same as with the built-in one
+int parseCodecOptions(int argc, char *argv[], CodecOptions &options) {
+    string promoter = PROMOTER, terminator = TERMINATOR, marker = MARKER;
+    int i = 1;
+    while (i < argc && strncmp(argv[i], "--", 2) == 0 && strcmp(argv[i], "--screen") != 0 &&
+           strcmp(argv[i], "--codons") != 0 && strcmp(argv[i], "--grep") != 0 &&
+           strcmp(argv[i], "--fm-index") != 0 && strcmp(argv[i], "--fm-find") != 0 &&
+           strcmp(argv[i], "--composition") != 0 && strcmp(argv[i], "--kmers") != 0) {
+        if (i + 1 >= argc) return -1;
+        const char *name = argv[i], *value = argv[i + 1];
+        bool valid;
+        if (strcmp(name, "--rs") == 0) {
+            valid = parseIntOption(value, 1, 128, options.rsParity);
+        } else if (strcmp(name, "--oligo-length") == 0) {
+            valid = parseIntOption(value, 48, 4096, options.oligoLength);
+        } else if (strcmp(name, "--oligo-group") == 0) {
+            valid = parseIntOption(value, 8, 128, options.oligoGroup) && options.oligoGroup % 8 == 0;
+        } else if (strcmp(name, "--oligo-parity") == 0) {
+            valid = parseIntOption(value, 0, 15, options.oligoParity);
+        } else if (strcmp(name, "--fountain") == 0) {
+            valid = parseIntOption(value, 1, 1000, options.fountainOverhead);
+        } else if (strcmp(name, "--cluster-memory") == 0) {
+            valid = parseIntOption(value, 16, 1 << 20, options.clusterMemory);
+        } else if (strcmp(name, "--escape-flanks") == 0) {
+            valid = parseIntOption(value, 0, 1, options.escapeFlanks);
+        } else if (strcmp(name, "--whiten") == 0) {
+            valid = parseIntOption(value, 1, INT_MAX, options.whitenSeed);
+        } else if (strcmp(name, "--gc-window") == 0) {
+            valid = parseIntOption(value, 10, 100000, options.gcWindow);
+        } else if (strcmp(name, "--gc-min") == 0) {
+            valid = parseIntOption(value, 0, 100, options.gcMin);
+        } else if (strcmp(name, "--gc-max") == 0) {
+            valid = parseIntOption(value, 0, 100, options.gcMax);
+        } else if (strcmp(name, "--max-run") == 0) {
+            valid = parseIntOption(value, 1, 100000, options.maxRun);
+        } else if (strcmp(name, "--motifs") == 0) {
+            valid = readMotifList(value, screenMotifs);
+        } else if (strcmp(name, "--rare-codons") == 0) {
+            valid = parseCodonList(value, options.rareCodons);
+        } else if (strcmp(name, "--translate") == 0) {
+            valid = parseIntOption(value, 0, 1, options.translate);
+        } else if (strcmp(name, "--rank-index") == 0) {
+            valid = parseIntOption(value, 0, 1, options.rankIndex);
+        } else if (strcmp(name, "--kmer-bloom") == 0) {
+            valid = parseIntOption(value, 0, 65536, options.kmerBloom);
+        } else if (strcmp(name, "--code") == 0) {
+            valid = strcmp(value, "plain") == 0 || strcmp(value, "rotating") == 0 || strcmp(value, "sense") == 0;
+            options.payloadCode = strcmp(value, "rotating") == 0 ? rotatingCode : strcmp(value, "sense") == 0 ? senseCode : plainCode;
+        } else if (strcmp(name, "--flanks") == 0) {
+            valid = readFlankConfig(value, promoter, terminator, marker);
+        } else if (strcmp(name, "--promoter") == 0) {
+            promoter = value;
+            valid = true;
+        } else if (strcmp(name, "--terminator") == 0) {
+            terminator = value;
+            valid = true;
+        } else if (strcmp(name, "--marker") == 0) {
+            marker = value;
+            valid = true;
+        } else {
+            valid = false;
+        }
+        if (!valid) return -1;
+        i += 2;
+    }
+    if (options.gcMin > options.gcMax) {
+        cerr << "--gc-min must not exceed --gc-max." << endl;
+        return -1;
+    }
+    if (options.fountainOverhead > 0 && options.oligoParity > 0) {
+        cerr << "--fountain replaces --oligo-parity, use one or the other." << endl;
+        return -1;
+    }
+    if (options.escapeFlanks && options.payloadCode != plainCode) {
+        cerr << "--escape-flanks applies to the plain code only." << endl;
+        return -1;
+    }
+    if (!compileFlankSet(promoter, terminator, marker, flankSet)) return -1;
+    options.flanks = flankSet.id;
+    // A sense payload is read in frame from its tag, so the TERMINATOR it starts with must hold no stop either
+    if (options.payloadCode == senseCode) {
+        string tag = payloadCodeTag(senseCode);
+        for (size_t c = 0; c + 3 <= tag.length(); c += 3) {
+            string codon = tag.substr(c, 3);
+            if (codon == "TAA" || codon == "TAG" || codon == "TGA") {
+                cerr << "The TERMINATOR puts a " << codon << " stop codon in frame, choose another for --code sense." << endl;
+                return -1;
+            }
+        }
+    }
+    return i;
+}
+
+string formatRecordOptions(const CodecOptions &options) {
+    string attributes;
+    if (options.rsParity > 0) attributes += "rs=" + to_string(options.rsParity);
+    if (options.flanks != 0) attributes += string(attributes.empty() ? "" : ",") + "flanks=" + to_string(options.flanks);
+    if (options.whitenSeed > 0) attributes += string(attributes.empty() ? "" : ",") + "whiten=" + to_string(options.whitenSeed);
+    return attributes;
+}
+
+bool parseRecordOptions(const string &attributes, CodecOptions &options) {
+    size_t start = 0;
+    while (start < attributes.length()) {
+        size_t end = attributes.find(',', start);
+        if (end == string::npos) end = attributes.length();
+        string attribute = attributes.substr(start, end - start);
+        size_t equals = attribute.find('=');
+        if (equals == string::npos) return false;
+
+        string key = attribute.substr(0, equals);
+        string value = attribute.substr(equals + 1);
+        if (value.empty() || value.find_first_not_of("0123456789") != string::npos) return false;
+
+        if (key == "rs") {
+            options.rsParity = atoi(value.c_str());
+            if (options.rsParity < 1 || options.rsParity > 128) return false;
+        } else if (key == "flanks") {
+            if (value.length() > 10 || stoull(value) > UINT32_MAX) return false;
+            options.flanks = (uint32_t)stoull(value);
+        } else if (key == "whiten") {
+            if (value.length() > 10 || stoull(value) > INT_MAX || stoull(value) == 0) return false;
+            options.whitenSeed = (int)stoull(value);
+        } else {
+            return false;
+        }
+        start = end + 1;
+    }
+    return true;
+}
+
+/*
+    Whitening.
+
+    Zero-filled regions and text map to long runs and repeats of a few words, which are hard
+    to synthesize and sequence. With --whiten, record bodies are XORed with a keystream before
+    the nucleotide mapping and again after it on decoding, which makes any body look random.
+    The seed is kept in the record header as "whiten=<seed>".
+
+    The keystream is counter based: word i is a SplitMix64 finalizer of the seed's key plus i
+    times the golden ratio, little-endian. Words do not depend on each other, so the loop runs
+    a word at a time with no carried state, and any offset can be whitened on its own.
+*/
+
+static inline uint64_t whiteningWord(uint64_t key, uint64_t index) {
+    uint64_t z = key + index * 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// XORs keystream bytes offset .. offset + length - 1 into data, its own inverse
+void whitenBytes(char *data, size_t length, uint32_t seed, uint64_t offset) {
+    const uint64_t key = whiteningWord(0, seed);
+    size_t i = 0;
+    for (; i < length && (offset + i) % 8 != 0; ++i) {
+        data[i] ^= (char)(whiteningWord(key, (offset + i) / 8) >> (8 * ((offset + i) % 8)));
+    }
+    for (uint64_t index = (offset + i) / 8; i + 8 <= length; i += 8, ++index) {
+        uint64_t word, stream = whiteningWord(key, index);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        stream = __builtin_bswap64(stream);
+#endif
+        memcpy(&word, data + i, 8);
+        word ^= stream;
+        memcpy(data + i, &word, 8);
+    }
+    for (; i < length; ++i) {
+        data[i] ^= (char)(whiteningWord(key, (offset + i) / 8) >> (8 * ((offset + i) % 8)));
+    }
+}
+
+/*
+    Reed-Solomon outer code.
+
+    Systematic RS(255, 255 - parity) over GF(256) with polynomial 0x11d and generator roots
+    alpha^0 .. alpha^(parity - 1), correcting 2 * errors + erasures <= parity per codeword.
+    Every byte is one 4-nucleotide word, so a substituted base costs one symbol.
+
+    The contents are zero-padded to whole codewords and cut into groups of up to 32
+    codewords that are byte-interleaved: a group is 255 rows of <depth> bytes, row i holding
+    byte i of each of its codewords. The data rows are the contents themselves, unchanged,
+    followed by the parity rows. This spreads a burst of base errors over many codewords and
+    lets the kernels work on whole rows, one codeword per SIMD lane, multiplying by a
+    constant with PSHUFB lookups into split low/high nibble product tables.
+*/
+
+static const size_t rsInterleave = 32;
+
+struct GaloisField {
+    uint8_t exp[512];
+    uint8_t log[256];
+    uint8_t mulLo[256][16];     // c * x for x < 16
+    uint8_t mulHi[256][16];     // c * (x << 4)
+
+    GaloisField() {
+        unsigned x = 1;
+        for (int i = 0; i < 255; ++i) {
+            exp[i] = exp[i + 255] = x;
+            log[x] = i;
+            x <<= 1;
+            if (x & 0x100) x ^= 0x11d;
+        }
+        exp[510] = exp[511] = exp[0];
+        log[0] = 0;
+        for (int c = 0; c < 256; ++c) {
+            for (int n = 0; n < 16; ++n) {
+                mulLo[c][n] = mul(c, n);
+                mulHi[c][n] = mul(c, n << 4);
+            }
+        }
+    }
+
+    uint8_t mul(uint8_t a, uint8_t b) const { return a && b ? exp[log[a] + log[b]] : 0; }
+    uint8_t div(uint8_t a, uint8_t b) const { return a ? exp[log[a] + 255 - log[b]] : 0; }
+};
+
+static const GaloisField &galoisField() {
+    static const GaloisField field;
+    return field;
+}
+
+// Generator polynomial, highest degree first
+static vector<uint8_t> rsGenerator(int parity) {
+    const GaloisField &gf = galoisField();
+    vector<uint8_t> gen(1, 1);
+    for (int j = 0; j < parity; ++j) {
+        gen.push_back(0);
+        for (size_t i = gen.size() - 1; i > 0; --i) gen[i] ^= gf.mul(gen[i - 1], gf.exp[j]);
+    }
+    return gen;
+}
+
+#ifdef DNA_CODEC_X86
+static bool cpuHasAVX2() {
+    static const bool has = __builtin_cpu_supports("avx2");
+    return has;
+}
+
+static bool cpuHasSSSE3() {
+    static const bool has = __builtin_cpu_supports("ssse3");
+    return has;
+}
+
+__attribute__((target("avx2")))
+static inline __m256i gfMulAVX2(__m256i v, __m256i lo, __m256i hi, __m256i mask) {
+    return _mm256_xor_si256(_mm256_shuffle_epi8(lo, _mm256_and_si256(v, mask)),
+                            _mm256_shuffle_epi8(hi, _mm256_and_si256(_mm256_srli_epi16(v, 4), mask)));
+}
+
+__attribute__((target("avx2")))
+static inline __m256i gfTableAVX2(const uint8_t *table) {
+    return _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)table));
+}
+
+__attribute__((target("ssse3")))
+static inline __m128i gfMulSSSE3(__m128i v, __m128i lo, __m128i hi, __m128i mask) {
+    return _mm_xor_si128(_mm_shuffle_epi8(lo, _mm_and_si128(v, mask)),
+                         _mm_shuffle_epi8(hi, _mm_and_si128(_mm_srli_epi16(v, 4), mask)));
+}
+
+// LFSR division by the generator for 32 codewords at once
+__attribute__((target("avx2")))
+static void rsEncodeLanesAVX2(const uint8_t *data, uint8_t *parity, size_t depth, size_t k, const vector<uint8_t> &gen) {
+    const GaloisField &gf = galoisField();
+    const int nsym = gen.size() - 1;
+    const __m256i mask = _mm256_set1_epi8(0x0f);
+    __m256i lo[128], hi[128], par[129];
+    for (int t = 0; t < nsym; ++t) {
+        lo[t] = gfTableAVX2(gf.mulLo[gen[t + 1]]);
+        hi[t] = gfTableAVX2(gf.mulHi[gen[t + 1]]);
+        par[t] = _mm256_setzero_si256();
+    }
+    par[nsym] = _mm256_setzero_si256();
+
+    for (size_t i = 0; i < k; ++i) {
+        __m256i fb = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(data + i * depth)), par[0]);
+        for (int t = 0; t < nsym; ++t) par[t] = _mm256_xor_si256(par[t + 1], gfMulAVX2(fb, lo[t], hi[t], mask));
+    }
+    for (int t = 0; t < nsym; ++t) _mm256_storeu_si256((__m256i *)(parity + t * depth), par[t]);
+}
+
+__attribute__((target("ssse3")))
+static void rsEncodeLanesSSSE3(const uint8_t *data, uint8_t *parity, size_t depth, size_t k, const vector<uint8_t> &gen) {
+    const GaloisField &gf = galoisField();
+    const int nsym = gen.size() - 1;
+    const __m128i mask = _mm_set1_epi8(0x0f);
+    __m128i lo[128], hi[128], par[129];
+    for (int t = 0; t < nsym; ++t) {
+        lo[t] = _mm_loadu_si128((const __m128i *)gf.mulLo[gen[t + 1]]);
+        hi[t] = _mm_loadu_si128((const __m128i *)gf.mulHi[gen[t + 1]]);
+        par[t] = _mm_setzero_si128();
+    }
+    par[nsym] = _mm_setzero_si128();
+
+    for (size_t i = 0; i < k; ++i) {
+        __m128i fb = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(data + i * depth)), par[0]);
+        for (int t = 0; t < nsym; ++t) par[t] = _mm_xor_si128(par[t + 1], gfMulSSSE3(fb, lo[t], hi[t], mask));
+    }
+    for (int t = 0; t < nsym; ++t) _mm_storeu_si128((__m128i *)(parity + t * depth), par[t]);
+}
+
+// Horner evaluation of each codeword at alpha^j for 32 codewords at once
+__attribute__((target("avx2")))
+static void rsSyndromeLanesAVX2(const uint8_t *group, uint8_t *syndromes, size_t depth, int nsym) {
+    const GaloisField &gf = galoisField();
+    const __m256i mask = _mm256_set1_epi8(0x0f);
+    __m256i lo[128], hi[128], syn[128];
+    for (int j = 0; j < nsym; ++j) {
+        lo[j] = gfTableAVX2(gf.mulLo[gf.exp[j]]);
+        hi[j] = gfTableAVX2(gf.mulHi[gf.exp[j]]);
+        syn[j] = _mm256_setzero_si256();
+    }
+
+    for (size_t i = 0; i < 255; ++i) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(group + i * depth));
+        for (int j = 0; j < nsym; ++j) syn[j] = _mm256_xor_si256(gfMulAVX2(syn[j], lo[j], hi[j], mask), v);
+    }
+    for (int j = 0; j < nsym; ++j) _mm256_storeu_si256((__m256i *)(syndromes + j * depth), syn[j]);
+}
+
+__attribute__((target("ssse3")))
+static void rsSyndromeLanesSSSE3(const uint8_t *group, uint8_t *syndromes, size_t depth, int nsym) {
+    const GaloisField &gf = galoisField();
+    const __m128i mask = _mm_set1_epi8(0x0f);
+    __m128i lo[128], hi[128], syn[128];
+    for (int j = 0; j < nsym; ++j) {
+        lo[j] = _mm_loadu_si128((const __m128i *)gf.mulLo[gf.exp[j]]);
+        hi[j] = _mm_loadu_si128((const __m128i *)gf.mulHi[gf.exp[j]]);
+        syn[j] = _mm_setzero_si128();
+    }
+
+    for (size_t i = 0; i < 255; ++i) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(group + i * depth));
+        for (int j = 0; j < nsym; ++j) syn[j] = _mm_xor_si128(gfMulSSSE3(syn[j], lo[j], hi[j], mask), v);
+    }
+    for (int j = 0; j < nsym; ++j) _mm_storeu_si128((__m128i *)(syndromes + j * depth), syn[j]);
+}
+#endif
+
+static void rsEncodeLaneScalar(const uint8_t *data, uint8_t *parity, size_t depth, size_t k, const vector<uint8_t> &gen) {
+    const GaloisField &gf = galoisField();
+    const int nsym = gen.size() - 1;
+    uint8_t par[129] = {0};
+    for (size_t i = 0; i < k; ++i) {
+        uint8_t fb = data[i * depth] ^ par[0];
+        const uint8_t *lo = gf.mulLo[fb], *hi = gf.mulHi[fb];
+        for (int t = 0; t < nsym; ++t) par[t] = par[t + 1] ^ lo[gen[t + 1] & 15] ^ hi[gen[t + 1] >> 4];
+    }
+    for (int t = 0; t < nsym; ++t) parity[t * depth] = par[t];
+}
+
+static void rsSyndromeLaneScalar(const uint8_t *group, uint8_t *syndromes, size_t depth, int nsym) {
+    const GaloisField &gf = galoisField();
+    for (int j = 0; j < nsym; ++j) {
+        const uint8_t *lo = gf.mulLo[gf.exp[j]], *hi = gf.mulHi[gf.exp[j]];
+        uint8_t syn = 0;
+        for (size_t i = 0; i < 255; ++i) syn = lo[syn & 15] ^ hi[syn >> 4] ^ group[i * depth];
+        syndromes[j * depth] = syn;
+    }
+}
+
+static void rsEncodeGroup(const uint8_t *data, uint8_t *parity, size_t depth, size_t k, const vector<uint8_t> &gen) {
+    size_t lane = 0;
+#ifdef DNA_CODEC_X86
+    if (cpuHasAVX2()) {
+        for (; lane + 32 <= depth; lane += 32) rsEncodeLanesAVX2(data + lane, parity + lane, depth, k, gen);
+    }
+    if (cpuHasSSSE3()) {
+        for (; lane + 16 <= depth; lane += 16) rsEncodeLanesSSSE3(data + lane, parity + lane, depth, k, gen);
+    }
+#endif
+    for (; lane < depth; ++lane) rsEncodeLaneScalar(data + lane, parity + lane, depth, k, gen);
+}
+
+static void rsSyndromeGroup(const uint8_t *group, uint8_t *syndromes, size_t depth, int nsym) {
+    size_t lane = 0;
+#ifdef DNA_CODEC_X86
+    if (cpuHasAVX2()) {
+        for (; lane + 32 <= depth; lane += 32) rsSyndromeLanesAVX2(group + lane, syndromes + lane, depth, nsym);
+    }
+    if (cpuHasSSSE3()) {
+        for (; lane + 16 <= depth; lane += 16) rsSyndromeLanesSSSE3(group + lane, syndromes + lane, depth, nsym);
+    }
+#endif
+    for (; lane < depth; ++lane) rsSyndromeLaneScalar(group + lane, syndromes + lane, depth, nsym);
+}
+
+// Errors-and-erasures decoding of one codeword: Berlekamp-Massey seeded with the erasure
+// locator, Chien search for the error positions and Forney for their values
+static bool rsCorrectCodeword(uint8_t *codeword, const uint8_t *syndromes, int parity,
+                              const vector<int> &erasures, size_t &corrected) {
+    const GaloisField &gf = galoisField();
+    const int rho = erasures.size();
+    if (rho > parity) return false;
+
+    // Polynomials below are lowest degree first; row i of a codeword has locator alpha^(254 - i)
+    uint8_t locator[130] = {1}, previous[130] = {0}, updated[130];
+    for (int e = 0; e < rho; ++e) {
+        uint8_t x = gf.exp[254 - erasures[e]];
+        for (int i = e + 1; i > 0; --i) locator[i] ^= gf.mul(locator[i - 1], x);
+    }
+    memcpy(previous, locator, sizeof(previous));
+
+    uint8_t previousDelta = 1;
+    int degree = rho, shift = 1;
+    for (int n = rho; n < parity; ++n) {
+        uint8_t delta = 0;
+        for (int i = 0; i <= degree && i <= n; ++i) delta ^= gf.mul(locator[i], syndromes[n - i]);
+        if (delta == 0) {
+            ++shift;
+            continue;
+        }
+
+        uint8_t scale = gf.div(delta, previousDelta);
+        memcpy(updated, locator, sizeof(updated));
+        for (int i = 0; i + shift <= parity; ++i) updated[i + shift] ^= gf.mul(scale, previous[i]);
+
+        if (2 * degree <= n + rho) {
+            memcpy(previous, locator, sizeof(previous));
+            previousDelta = delta;
+            degree = n + 1 + rho - degree;
+            shift = 1;
+        } else {
+            ++shift;
+        }
+        memcpy(locator, updated, sizeof(locator));
+    }
+    if (2 * degree - rho > parity) return false;
+    for (int i = degree + 1; i <= parity; ++i) {
+        if (locator[i] != 0) return false;
+    }
+
+    // Chien search
+    int rows[130], found = 0;
+    for (int row = 0; row < 255 && found <= degree; ++row) {
+        uint8_t xInverse = gf.exp[row + 1];     // alpha^-(254 - row)
+        uint8_t value = 0;
+        for (int i = degree; i >= 0; --i) value = gf.mul(value, xInverse) ^ locator[i];
+        if (value == 0) rows[found++] = row;
+    }
+    if (found != degree) return false;
+
+    // Forney: error evaluator Omega = S * Lambda mod x^parity
+    uint8_t omega[128] = {0};
+    for (int i = 0; i < parity; ++i) {
+        for (int j = 0; j <= i && j <= degree; ++j) omega[i] ^= gf.mul(syndromes[i - j], locator[j]);
+    }
+
+    for (int e = 0; e < found; ++e) {
+        uint8_t x = gf.exp[254 - rows[e]];
+        uint8_t xInverse = gf.exp[rows[e] + 1];
+        uint8_t xInverse2 = gf.mul(xInverse, xInverse);
+        uint8_t numerator = 0, denominator = 0;
+        for (int i = parity - 1; i >= 0; --i) numerator = gf.mul(numerator, xInverse) ^ omega[i];
+        for (int i = degree - (degree % 2 == 0); i >= 1; i -= 2) denominator = gf.mul(denominator, xInverse2) ^ locator[i];
+        if (denominator == 0) return false;
+
+        uint8_t magnitude = gf.mul(x, gf.div(numerator, denominator));
+        if (magnitude != 0) {
+            codeword[rows[e]] ^= magnitude;
+            ++corrected;
+        }
+    }
+    return true;
+}
+
+size_t rsEncodedLength(size_t dataLength, int parity) {
+    size_t k = 255 - parity;
+    return (dataLength + k - 1) / k * 255;
+}
+
+string rsEncode(const string &data, int parity) {
+    const size_t k = 255 - parity;
+    const size_t codewords = (data.length() + k - 1) / k;
+    const vector<uint8_t> gen = rsGenerator(parity);
+
+    string encoded, tail;
+    encoded.reserve(codewords * 255);
+    vector<uint8_t> parityRows(parity * rsInterleave);
+    for (size_t first = 0; first < codewords; first += rsInterleave) {
+        size_t depth = min(rsInterleave, codewords - first);
+        const char *in = data.data() + first * k;
+        if ((first + depth) * k > data.length()) {
+            // Zero-pad the last group to whole codewords
+            tail.assign(in, data.length() - first * k);
+            tail.resize(depth * k, '\0');
+            in = tail.data();
+        }
+        rsEncodeGroup((const uint8_t *)in, parityRows.data(), depth, k, gen);
+        encoded.append(in, depth * k);
+        encoded.append((const char *)parityRows.data(), parity * depth);
+    }
+    return encoded;
+}
+
+// Decode an interleaved body into its data rows; erasures are byte offsets into encoded
+bool rsDecode(const string &encoded, int parity, string &data, size_t &corrected, const vector<size_t> &erasures) {
+    if (encoded.length() % 255 != 0) return false;
+    const size_t k = 255 - parity;
+    const size_t codewords = encoded.length() / 255;
+    const size_t groupLength = rsInterleave * 255;
+
+    unordered_map<size_t, vector<int>> erasedRows;    // codeword -> erased rows
+    for (size_t position : erasures) {
+        if (position >= encoded.length()) continue;
+        size_t first = position / groupLength * rsInterleave;
+        size_t depth = min(rsInterleave, codewords - first);
+        size_t offset = position % groupLength;
+        erasedRows[first + offset % depth].push_back(offset / depth);
+    }
+    const vector<int> noErasures;
+
+    string result, scratch;
+    result.reserve(codewords * k);
+    vector<uint8_t> syndromes(parity * rsInterleave);
+    uint8_t codeword[255], laneSyndromes[128];
+
+    for (size_t first = 0; first < codewords; first += rsInterleave) {
+        size_t depth = min(rsInterleave, codewords - first);
+        const uint8_t *group = (const uint8_t *)encoded.data() + first * 255;
+        rsSyndromeGroup(group, syndromes.data(), depth, parity);
+
+        // Only groups with a failing syndrome are copied and corrected
+        uint8_t *fixed = nullptr;
+        for (size_t lane = 0; lane < depth; ++lane) {
+            uint8_t any = 0;
+            for (int j = 0; j < parity; ++j) any |= laneSyndromes[j] = syndromes[j * depth + lane];
+            if (any == 0) continue;
+
+            if (fixed == nullptr) {
+                scratch.assign((const char *)group, depth * 255);
+                fixed = (uint8_t *)&scratch[0];
+            }
+            for (size_t i = 0; i < 255; ++i) codeword[i] = fixed[i * depth + lane];
+
+            // Erasure flags are hints; if they do not lead to a codeword, retry without them
+            unordered_map<size_t, vector<int>>::const_iterator erased = erasedRows.find(first + lane);
+            if (!rsCorrectCodeword(codeword, laneSyndromes, parity,
+                                   erased == erasedRows.end() ? noErasures : erased->second, corrected)) {
+                if (erased == erasedRows.end()) return false;
+                for (size_t i = 0; i < 255; ++i) codeword[i] = fixed[i * depth + lane];
+                if (!rsCorrectCodeword(codeword, laneSyndromes, parity, noErasures, corrected)) return false;
+            }
+            for (size_t i = 0; i < 255; ++i) fixed[i * depth + lane] = codeword[i];
+        }
+        result.append((const char *)(fixed != nullptr ? fixed : group), depth * k);
+    }
+
+    data.swap(result);
+    return true;
+}
+
+/*
+    Cross-oligo erasure code.
+
+    A single oligo that drops out entirely is a run of erasures no per-oligo code can fill,
+    so oligo payloads ("stripes") are also protected across oligos. Stripes are taken in
+    groups of <dataStripes>, each followed by <parityStripes> parity stripes; the last group
+    may be shorter, with its missing data stripes treated as zeros. Parity stripe j is
+    sum(matrix[j][i] * data[i]) over GF(256) with a Cauchy matrix whose columns are scaled
+    so the first row is all ones: one parity stripe is plain XOR, and any <parityStripes>
+    lost stripes of a group can be rebuilt. The region kernels multiply-accumulate whole
+    stripes with the same PSHUFB split tables as the Reed-Solomon kernels, and groups are
+    encoded and rebuilt in parallel.
+*/
+
+#ifdef DNA_CODEC_X86
+__attribute__((target("avx2")))
+static size_t gfRegionMulAddAVX2(uint8_t *dst, const uint8_t *src, uint8_t c, size_t length) {
+    const GaloisField &gf = galoisField();
+    const __m256i mask = _mm256_set1_epi8(0x0f);
+    const __m256i lo = gfTableAVX2(gf.mulLo[c]), hi = gfTableAVX2(gf.mulHi[c]);
+    size_t i = 0;
+    for (; i + 32 <= length; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(src + i));
+        __m256i d = _mm256_loadu_si256((const __m256i *)(dst + i));
+        __m256i product = c == 1 ? v : gfMulAVX2(v, lo, hi, mask);
+        _mm256_storeu_si256((__m256i *)(dst + i), _mm256_xor_si256(d, product));
+    }
+    return i;
+}
+
+__attribute__((target("ssse3")))
+static size_t gfRegionMulAddSSSE3(uint8_t *dst, const uint8_t *src, uint8_t c, size_t length) {
+    const GaloisField &gf = galoisField();
+    const __m128i mask = _mm_set1_epi8(0x0f);
+    const __m128i lo = _mm_loadu_si128((const __m128i *)gf.mulLo[c]);
+    const __m128i hi = _mm_loadu_si128((const __m128i *)gf.mulHi[c]);
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+        __m128i d = _mm_loadu_si128((const __m128i *)(dst + i));
+        __m128i product = c == 1 ? v : gfMulSSSE3(v, lo, hi, mask);
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_xor_si128(d, product));
+    }
+    return i;
+}
+#endif
+
+// dst ^= c * src over a whole stripe
+static void gfRegionMulAdd(uint8_t *dst, const uint8_t *src, uint8_t c, size_t length) {
+    if (c == 0) return;
+    size_t i = 0;
+#ifdef DNA_CODEC_X86
+    if (cpuHasAVX2()) i = gfRegionMulAddAVX2(dst, src, c, length);
+    else if (cpuHasSSSE3()) i = gfRegionMulAddSSSE3(dst, src, c, length);
+#endif
+    const GaloisField &gf = galoisField();
+    for (; i < length; ++i) dst[i] ^= gf.mulLo[c][src[i] & 15] ^ gf.mulHi[c][src[i] >> 4];
+}
+
+ErasureCode makeErasureCode(int dataStripes, int parityStripes) {
+    const GaloisField &gf = galoisField();
+    ErasureCode code;
+    code.dataStripes = dataStripes;
+    code.parityStripes = parityStripes;
+    code.matrix.resize(parityStripes * dataStripes);
+
+    // Cauchy 1 / (x_j + y_i) with x_j = j, y_i = parityStripes + i, columns scaled by 1 / c[0][i];
+    // the x and y values must be distinct field elements, so dataStripes + parityStripes <= 256
+    for (int i = 0; i < dataStripes; ++i) {
+        uint8_t scale = gf.div(1, gf.div(1, parityStripes + i));
+        for (int j = 0; j < parityStripes; ++j) {
+            code.matrix[j * dataStripes + i] = gf.mul(gf.div(1, j ^ (parityStripes + i)), scale);
+        }
+    }
+    return code;
+}
+
+size_t erasureGroupCount(size_t stripes, const ErasureCode &code) {
+    return (stripes + code.dataStripes - 1) / code.dataStripes;
+}
+
+// Data stripes in, data stripes with parity stripes after each group out
+string erasureEncodeStripes(const string &stripes, size_t stripeLength, const ErasureCode &code) {
+    const size_t k = code.dataStripes, m = code.parityStripes;
+    const size_t dataCount = stripes.length() / stripeLength;
+    const size_t groups = erasureGroupCount(dataCount, code);
+
+    string encoded(stripes.length() + groups * m * stripeLength, '\0');
+    parallelFor(groups, [&](size_t begin, size_t end) {
+        for (size_t g = begin; g < end; ++g) {
+            size_t groupData = min(k, dataCount - g * k);
+            const uint8_t *in = (const uint8_t *)stripes.data() + g * k * stripeLength;
+            uint8_t *out = (uint8_t *)&encoded[g * (k + m) * stripeLength];
+            memcpy(out, in, groupData * stripeLength);
+
+            uint8_t *parity = out + groupData * stripeLength;
+            for (size_t j = 0; j < m; ++j) {
+                for (size_t i = 0; i < groupData; ++i) {
+                    gfRegionMulAdd(parity + j * stripeLength, in + i * stripeLength, code.matrix[j * k + i], stripeLength);
+                }
+            }
+        }
+    });
+    return encoded;
+}
+
+// Invert a square matrix over GF(256) by Gauss-Jordan elimination
+static bool gfInvertMatrix(vector<uint8_t> &matrix, size_t n) {
+    const GaloisField &gf = galoisField();
+    vector<uint8_t> inverse(n * n, 0);
+    for (size_t i = 0; i < n; ++i) inverse[i * n + i] = 1;
+
+    for (size_t col = 0; col < n; ++col) {
+        size_t pivot = col;
+        while (pivot < n && matrix[pivot * n + col] == 0) ++pivot;
+        if (pivot == n) return false;
+        for (size_t c = 0; c < n; ++c) {
+            swap(matrix[pivot * n + c], matrix[col * n + c]);
+            swap(inverse[pivot * n + c], inverse[col * n + c]);
+        }
+
+        uint8_t scale = gf.div(1, matrix[col * n + col]);
+        for (size_t c = 0; c < n; ++c) {
+            matrix[col * n + c] = gf.mul(matrix[col * n + c], scale);
+            inverse[col * n + c] = gf.mul(inverse[col * n + c], scale);
+        }
+        for (size_t r = 0; r < n; ++r) {
+            uint8_t factor = matrix[r * n + col];
+            if (r == col || factor == 0) continue;
+            for (size_t c = 0; c < n; ++c) {
+                matrix[r * n + c] ^= gf.mul(factor, matrix[col * n + c]);
+                inverse[r * n + c] ^= gf.mul(factor, inverse[col * n + c]);
+            }
+        }
+    }
+    matrix.swap(inverse);
+    return true;
+}
+
+// Rebuild missing stripes of an encoded stripe buffer in place, group by group; false if some group
+// had too few stripes left, whose stripes then stay missing while every other group is rebuilt
+bool erasureRebuildStripes(string &stripes, vector<bool> &present, size_t stripeLength,
+                           const ErasureCode &code, size_t &rebuilt) {
+    const size_t k = code.dataStripes, m = code.parityStripes;
+    const size_t total = stripes.length() / stripeLength;
+    const size_t groups = (total + k + m - 1) / (k + m);
+    if (present.size() != total || total <= (groups - 1) * (k + m) + m) return false;
+
+    vector<size_t> groupRebuilt(groups, 0);
+    vector<char> groupFailed(groups, 0);
+    parallelFor(groups, [&](size_t begin, size_t end) {
+        for (size_t g = begin; g < end; ++g) {
+            size_t first = g * (k + m);
+            size_t groupData = min(k + m, total - first) - m;
+            uint8_t *base = (uint8_t *)&stripes[first * stripeLength];
+
+            vector<size_t> missingData, missingParity, parityRows;
+            for (size_t s = 0; s < groupData + m; ++s) {
+                if (!present[first + s]) {
+                    if (s < groupData) missingData.push_back(s);
+                    else missingParity.push_back(s - groupData);
+                } else if (s >= groupData && parityRows.size() < groupData) {
+                    parityRows.push_back(s - groupData);
+                }
+            }
+            if (missingData.empty() && missingParity.empty()) continue;
+
+            const size_t e = missingData.size();
+            if (e > 0) {
+                if (parityRows.size() < e) {
+                    groupFailed[g] = 1;
+                    continue;
+                }
+                parityRows.resize(e);
+
+                // Parity j minus the surviving data terms leaves sum(C[j][d] * data[d]) over the
+                // missing d; the e x e Cauchy submatrix is always invertible
+                vector<uint8_t> sub(e * e);
+                for (size_t r = 0; r < e; ++r) {
+                    for (size_t c = 0; c < e; ++c) sub[r * e + c] = code.matrix[parityRows[r] * k + missingData[c]];
+                }
+                if (!gfInvertMatrix(sub, e)) {
+                    groupFailed[g] = 1;
+                    continue;
+                }
+
+                vector<uint8_t> syndromes(e * stripeLength);
+                for (size_t r = 0; r < e; ++r) {
+                    uint8_t *syndrome = &syndromes[r * stripeLength];
+                    memcpy(syndrome, base + (groupData + parityRows[r]) * stripeLength, stripeLength);
+                    for (size_t i = 0; i < groupData; ++i) {
+                        if (present[first + i]) {
+                            gfRegionMulAdd(syndrome, base + i * stripeLength, code.matrix[parityRows[r] * k + i], stripeLength);
+                        }
+                    }
+                }
+                for (size_t c = 0; c < e; ++c) {
+                    uint8_t *out = base + missingData[c] * stripeLength;
+                    memset(out, 0, stripeLength);
+                    for (size_t r = 0; r < e; ++r) gfRegionMulAdd(out, &syndromes[r * stripeLength], sub[c * e + r], stripeLength);
+                }
+            }
+            for (size_t j : missingParity) {
+                uint8_t *out = base + (groupData + j) * stripeLength;
+                memset(out, 0, stripeLength);
+                for (size_t i = 0; i < groupData; ++i) {
+                    gfRegionMulAdd(out, base + i * stripeLength, code.matrix[j * k + i], stripeLength);
+                }
+            }
+            groupRebuilt[g] = missingData.size() + missingParity.size();
+        }
+    });
+
+    // vector<bool> packs bits, so presence is only written back once the threads are done
+    bool complete = true;
+    for (size_t g = 0; g < groups; ++g) {
+        if (groupFailed[g]) {
+            complete = false;
+            continue;
+        }
+        rebuilt += groupRebuilt[g];
+        fill(present.begin() + g * (k + m), present.begin() + min(total, (g + 1) * (k + m)), true);
+    }
+    return complete;
+}
+
+/*
+    Oligo segmentation.
+
+    Synthesis works on short oligos, so -s cuts a file record (the same bytes a .dna file
+    carries) into fixed-size stripes and writes each as one addressed oligo:
+
+        PROMOTER | index (4) | layout (1) | stripe | CRC-16 (2) | TERMINATOR
+
+    Field sizes are in bytes, 4 nucleotides each. The index is big-endian, the layout byte
+    holds the parity oligos per group in its high nibble and the data oligos per group / 8 - 1
+    in its low nibble, and the CRC covers index, layout and stripe. With parity oligos the
+    record is padded to whole erasure groups, so every group is full and an oligo's role
+    follows from its index alone. Without them the layout byte is 0, which leaves 0x0F, a
+    group size with no parity, to mark fountain droplets.
+*/
+
+static const size_t oligoAddressBytes = 5;
+static const size_t oligoChecksumBytes = 2;
+static const size_t oligoMaxBytes = oligoAddressBytes + 1024 + oligoChecksumBytes;     // 4096 nt payload
+static const uint8_t fountainLayoutByte = 0x0F;
+static const uint32_t fountainSeedMask = 0x1B1B1B1B;    // ACGT repeats in place of the leading zeros of small seeds
+
+OligoLayout oligoLayoutFor(const CodecOptions &options) {
+    OligoLayout layout;
+    size_t flanks = flankSet.promoter.length() + flankSet.terminator.length();
+    size_t payload = (size_t)options.oligoLength > flanks ? (options.oligoLength - flanks) / 4 : 0;
+    layout.stripeLength = payload > oligoAddressBytes + oligoChecksumBytes ? payload - oligoAddressBytes - oligoChecksumBytes : 0;
+    layout.groupStripes = options.oligoGroup;
+    layout.parityStripes = options.oligoParity;
+    layout.fountain = options.fountainOverhead > 0;
+    return layout;
+}
+
+size_t oligoSequenceLength(const OligoLayout &layout) {
+    return flankSet.promoter.length() + 4 * (oligoAddressBytes + layout.stripeLength + oligoChecksumBytes) +
+           flankSet.terminator.length();
+}
+
+// CRC-16/CCITT-FALSE
+uint16_t crc16(const unsigned char *data, size_t length) {
+    struct Table {
+        uint16_t entries[256];
+        Table() {
+            for (int i = 0; i < 256; ++i) {
+                uint16_t crc = i << 8;
+                for (int bit = 0; bit < 8; ++bit) crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+                entries[i] = crc;
+            }
+        }
+    };
+    static const Table table;
+
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < length; ++i) crc = (crc << 8) ^ table.entries[((crc >> 8) ^ data[i]) & 0xFF];
+    return crc;
+}
+
+// Stripes of the record, padded and followed by each group's parity stripes
+string segmentRecord(const string &record, const OligoLayout &layout) {
+    size_t unit = layout.stripeLength * (layout.parityStripes > 0 ? layout.groupStripes : 1);
+    string stripes = record;
+    stripes.resize((record.length() + unit - 1) / unit * unit, '\0');
+    if (layout.parityStripes == 0) return stripes;
+    return erasureEncodeStripes(stripes, layout.stripeLength, makeErasureCode(layout.groupStripes, layout.parityStripes));
+}
+
+void formatOligo(uint32_t index, const OligoLayout &layout, const unsigned char *stripe, char *dnaSeq) {
+    unsigned char bytes[oligoMaxBytes];
+    size_t payloadEnd = oligoAddressBytes + layout.stripeLength;
+    if (layout.fountain) index ^= fountainSeedMask;
+    bytes[0] = index >> 24;
+    bytes[1] = index >> 16;
+    bytes[2] = index >> 8;
+    bytes[3] = index;
+    bytes[4] = layout.fountain ? fountainLayoutByte :
+               layout.parityStripes > 0 ? (layout.parityStripes << 4) | (layout.groupStripes / 8 - 1) : 0;
+    memcpy(bytes + oligoAddressBytes, stripe, layout.stripeLength);
+    uint16_t crc = crc16(bytes, payloadEnd);
+    bytes[payloadEnd] = crc >> 8;
+    bytes[payloadEnd + 1] = crc;
+
+    size_t promoter = flankSet.promoter.length();
+    memcpy(dnaSeq, flankSet.promoter.data(), promoter);
+    bytesToNucleotide(bytes, payloadEnd + oligoChecksumBytes, dnaSeq + promoter);
+    memcpy(dnaSeq + promoter + 4 * (payloadEnd + oligoChecksumBytes), flankSet.terminator.data(), flankSet.terminator.length());
+}
+
+// One ">oligo_<index>" record per stripe, formatted in parallel batches and written in order;
+// the index is the stripe's position unless indices gives one per stripe
+bool writeOligoFasta(ostream &out, const string &stripes, const OligoLayout &layout, const vector<uint32_t> *indices) {
+    const size_t count = stripes.length() / layout.stripeLength;
+    const size_t sequenceLength = oligoSequenceLength(layout);
+    const size_t batchSize = 1 << 18;
+    const size_t pieces = max(1u, thread::hardware_concurrency());
+
+    vector<string> text(pieces);
+    for (size_t batch = 0; batch < count; batch += batchSize) {
+        size_t batchEnd = min(count, batch + batchSize);
+        parallelFor(pieces, [&](size_t begin, size_t end) {
+            for (size_t piece = begin; piece < end; ++piece) {
+                size_t first = batch + (batchEnd - batch) * piece / pieces;
+                size_t last = batch + (batchEnd - batch) * (piece + 1) / pieces;
+                string &buffer = text[piece];
+                buffer.clear();
+                buffer.reserve((last - first) * (sequenceLength + 20));
+                for (size_t i = first; i < last; ++i) {
+                    uint32_t index = indices != nullptr ? (*indices)[i] : (uint32_t)i;
+                    buffer += ">oligo_" + to_string(index) + "\n";
+                    size_t start = buffer.length();
+                    buffer.resize(start + sequenceLength + 1);
+                    formatOligo(index, layout, (const unsigned char *)stripes.data() + i * layout.stripeLength, &buffer[start]);
+                    buffer[start + sequenceLength] = '\n';
+                }
+            }
+        });
+        for (const string &buffer : text) out.write(buffer.data(), buffer.length());
+        if (!out) return false;
+    }
+    return true;
+}
+
+/*
+    Fountain code.
+
+    With --fountain <percent>, -s writes the droplets of a Luby transform code instead of
+    addressed stripes, as DNA Fountain does. The record is cut into K segments, and the
+    droplet of seed s is the XOR of a set of segments drawn from s alone, its size from the
+    robust soliton distribution. The oligo's index carries the seed XOR fountainSeedMask, its
+    layout byte is fountainLayoutByte and its stripe starts with K, so every droplet stands on
+    its own. Each stripe, K included, is whitened with its seed and the whole oligo screened
+    against --max-run and --gc-min/--gc-max; seeds that fail are skipped until
+    K * (100 + percent) / 100 droplets pass. Batches of seeds are built and screened in
+    parallel and kept in seed order, so the output does not depend on the thread count.
+
+    Any set of droplets a little larger than K decodes, whichever oligos were lost. -j peels:
+    a droplet down to one unsolved segment gives that segment, which is XORed out of every
+    other droplet holding it. If peeling stalls, Gauss-Jordan elimination over GF(2), with the
+    unsolved segments of each droplet as a bitset row, solves what the rest determine.
+    Segments still unknown go to the outer code as erasures.
+*/
+
+static const size_t fountainHeaderBytes = 4;            // K, big-endian, at the start of each droplet stripe
+static const size_t fountainMaxEliminated = 8192;       // unsolved segments left to elimination at most
+
+// Cumulative robust soliton distribution of degrees 1 .. k, with c = 0.1 and delta = 0.5
+static vector<double> robustSoliton(size_t k) {
+    const double c = 0.1, delta = 0.5;
+    const double r = c * log(k / delta) * sqrt((double)k);
+    const size_t spike = min(k, max<size_t>(1, (size_t)(k / r)));
+    vector<double> cdf(k);
+    double total = 0;
+    for (size_t d = 1; d <= k; ++d) {
+        double p = d == 1 ? 1.0 / k : 1.0 / (d * (d - 1.0));
+        if (d < spike) p += r / (d * (double)k);
+        else if (d == spike) p += r * max(0.0, log(r / delta)) / k;
+        total += p;
+        cdf[d - 1] = total;
+    }
+    for (double &p : cdf) p /= total;
+    return cdf;
+}
+
+// The segments XORed into the droplet of a seed, sorted
+static void fountainNeighbours(uint32_t seed, size_t k, const vector<double> &cdf, vector<uint32_t> &segments) {
+    const uint64_t key = whiteningWord(~uint64_t(0), seed);
+    double u = (whiteningWord(key, 0) >> 11) * (1.0 / 9007199254740992.0);
+    size_t degree = min(k, (size_t)(lower_bound(cdf.begin(), cdf.end(), u) - cdf.begin()) + 1);
+
+    // Floyd's sampling, one draw per segment; the soliton's 1/d tail makes a few degrees near k
+    static thread_local vector<bool> taken;     // all clear between calls
+    const bool wide = degree > 64;
+    if (wide && taken.size() < k) taken.assign(k, false);
+    segments.clear();
+    for (size_t j = k - degree; j < k; ++j) {
+        uint32_t s = (uint32_t)(((whiteningWord(key, j - (k - degree) + 1) >> 32) * (j + 1)) >> 32);
+        if (wide ? taken[s] : find(segments.begin(), segments.end(), s) != segments.end()) s = (uint32_t)j;
+        if (wide) taken[s] = true;
+        segments.push_back(s);
+    }
+    if (wide) {
+        for (uint32_t s : segments) taken[s] = false;
+    }
+    sort(segments.begin(), segments.end());
+}
+
+// dst ^= src a word at a time; droplet payloads are too short for the SIMD region kernels to pay off
+static inline void xorRegion(uint8_t *dst, const uint8_t *src, size_t length) {
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+        uint64_t a, b;
+        memcpy(&a, dst + i, 8);
+        memcpy(&b, src + i, 8);
+        a ^= b;
+        memcpy(dst + i, &a, 8);
+    }
+    for (; i < length; ++i) dst[i] ^= src[i];
+}
+
+// Longest run and GC share of a whole oligo within the --screen limits
+static bool screenDroplet(const char *dnaSeq, size_t length, const CodecOptions &options) {
+    size_t gc = 0, run = 0;
+    for (size_t i = 0; i < length; ++i) {
+        gc += dnaSeq[i] == 'C' || dnaSeq[i] == 'G';
+        run = i > 0 && dnaSeq[i] == dnaSeq[i - 1] ? run + 1 : 1;
+        if (run > (size_t)options.maxRun) return false;
+    }
+    return gc * 100 >= options.gcMin * length && gc * 100 <= options.gcMax * length;
+}
+
+// Droplets in seed order with their seeds; false if a whole batch of seeds fails the screen
+bool fountainEncode(const string &record, const OligoLayout &layout, const CodecOptions &options, string &stripes,
+                    vector<uint32_t> &seeds) {
+    const size_t segmentLength = layout.stripeLength - fountainHeaderBytes;
+    const size_t k = max<size_t>(1, (record.length() + segmentLength - 1) / segmentLength);
+    const size_t target = (k * (100 + options.fountainOverhead) + 99) / 100;
+    const size_t sequenceLength = oligoSequenceLength(layout);
+    const size_t batchSize = min<size_t>(1 << 16, target + target / 4 + 64);
+    const vector<double> cdf = robustSoliton(k);
+    string segments = record;
+    segments.resize(k * segmentLength, '\0');
+
+    stripes.clear();
+    stripes.reserve(target * layout.stripeLength);
+    seeds.clear();
+    string batch(batchSize * layout.stripeLength, '\0');
+    vector<char> passed(batchSize);
+    for (uint64_t first = 0; seeds.size() < target; first += batchSize) {
+        if (first + batchSize > (uint64_t)UINT32_MAX + 1) return false;
+        parallelFor(batchSize, [&](size_t begin, size_t end) {
+            vector<uint32_t> neighbours;
+            string oligo(sequenceLength, '\0');
+            for (size_t i = begin; i < end; ++i) {
+                uint32_t seed = (uint32_t)(first + i);
+                unsigned char *stripe = (unsigned char *)&batch[i * layout.stripeLength];
+                for (size_t b = 0; b < fountainHeaderBytes; ++b) stripe[b] = (unsigned char)(k >> (8 * (3 - b)));
+                uint8_t *payload = stripe + fountainHeaderBytes;
+                memset(payload, 0, segmentLength);
+                fountainNeighbours(seed, k, cdf, neighbours);
+                for (uint32_t s : neighbours) {
+                    xorRegion(payload, (const uint8_t *)segments.data() + s * segmentLength, segmentLength);
+                }
+                whitenBytes((char *)stripe, layout.stripeLength, seed);
+                formatOligo(seed, layout, stripe, &oligo[0]);
+                passed[i] = screenDroplet(oligo.data(), sequenceLength, options);
+            }
+        });
+        size_t kept = 0;
+        for (size_t i = 0; i < batchSize && seeds.size() < target; ++i) {
+            if (!passed[i]) continue;
+            stripes.append(batch, i * layout.stripeLength, layout.stripeLength);
+            seeds.push_back((uint32_t)(first + i));
+            ++kept;
+        }
+        if (kept == 0) return false;
+    }
+    return true;
+}
+
+// The record from the droplets present, indexed by seed; false if none is usable
+bool fountainDecode(const string &stripes, const vector<bool> &present, size_t stripeLength, string &record,
+                    vector<size_t> &erasures, FountainStats &stats) {
+    const size_t segmentLength = stripeLength - fountainHeaderBytes;
+
+    // An unverified droplet would spread its wrong bytes to every segment it solves; none are placed, and any
+    // droplet with erasures is still left out
+    vector<bool> usable = present;
+    for (size_t b : erasures) usable[b / stripeLength] = false;
+    size_t k = 0;
+    vector<uint32_t> seeds;
+    for (size_t i = 0; i < usable.size(); ++i) {
+        if (!usable[i]) continue;
+        unsigned char header[fountainHeaderBytes];
+        memcpy(header, stripes.data() + i * stripeLength, fountainHeaderBytes);
+        whitenBytes((char *)header, fountainHeaderBytes, (uint32_t)i);
+        size_t count = ((size_t)header[0] << 24) | (header[1] << 16) | (header[2] << 8) | header[3];
+        if (k == 0) k = count;
+        if (count == k && k > 0) seeds.push_back((uint32_t)i);
+    }
+    if (seeds.empty()) return false;
+
+    const size_t n = seeds.size();
+    const vector<double> cdf = robustSoliton(k);
+    vector<vector<uint32_t>> neighbours(n);
+    string payloads(n * segmentLength, '\0');
+    parallelFor(n, [&](size_t begin, size_t end) {
+        for (size_t d = begin; d < end; ++d) {
+            fountainNeighbours(seeds[d], k, cdf, neighbours[d]);
+            memcpy(&payloads[d * segmentLength], stripes.data() + seeds[d] * stripeLength + fountainHeaderBytes, segmentLength);
+            whitenBytes(&payloads[d * segmentLength], segmentLength, seeds[d], fountainHeaderBytes);
+        }
+    });
+
+    // Droplets holding each segment, as compressed rows
+    vector<size_t> start(k + 1, 0);
+    for (const vector<uint32_t> &list : neighbours) {
+        for (uint32_t s : list) ++start[s + 1];
+    }
+    for (size_t s = 0; s < k; ++s) start[s + 1] += start[s];
+    vector<uint32_t> holders(start[k]);
+    vector<size_t> fill(start.begin(), start.end() - 1);
+    for (size_t d = 0; d < n; ++d) {
+        for (uint32_t s : neighbours[d]) holders[fill[s]++] = (uint32_t)d;
+    }
+
+    // Peeling; degree counts the unsolved segments still XORed into each droplet
+    record.assign(k * segmentLength, '\0');
+    vector<bool> solved(k, false), used(n, false);
+    vector<uint32_t> degree(n), ready;
+    for (size_t d = 0; d < n; ++d) {
+        degree[d] = (uint32_t)neighbours[d].size();
+        if (degree[d] == 1) ready.push_back((uint32_t)d);
+    }
+    stats.segments = k;
+    stats.droplets = n;
+    stats.peeled = stats.eliminated = 0;
+    while (!ready.empty()) {
+        uint32_t d = ready.back();
+        ready.pop_back();
+        if (used[d] || degree[d] != 1) continue;
+        used[d] = true;
+        uint32_t segment = *find_if(neighbours[d].begin(), neighbours[d].end(), [&](uint32_t s) { return !solved[s]; });
+        solved[segment] = true;
+        ++stats.peeled;
+        uint8_t *value = (uint8_t *)&record[segment * segmentLength];
+        memcpy(value, &payloads[d * segmentLength], segmentLength);
+        for (size_t h = start[segment]; h < start[segment + 1]; ++h) {
+            uint32_t e = holders[h];
+            if (used[e]) continue;
+            xorRegion((uint8_t *)&payloads[e * segmentLength], value, segmentLength);
+            if (--degree[e] == 1) ready.push_back(e);
+        }
+    }
+
+    vector<uint32_t> unsolved;
+    for (size_t s = 0; s < k; ++s) {
+        if (!solved[s]) unsolved.push_back((uint32_t)s);
+    }
+    const size_t u = unsolved.size();
+    if (u > 0 && u <= fountainMaxEliminated) {
+        // One bitset row over the unsolved segments per droplet left, its payload already reduced by peeling
+        const size_t words = (u + 63) / 64;
+        vector<uint32_t> column(k, 0), rows;
+        for (size_t c = 0; c < u; ++c) column[unsolved[c]] = (uint32_t)c;
+        for (size_t d = 0; d < n && rows.size() < 2 * u + 64; ++d) {
+            if (!used[d] && degree[d] >= 2) rows.push_back((uint32_t)d);
+        }
+        vector<uint64_t> bits(rows.size() * words, 0);
+        for (size_t r = 0; r < rows.size(); ++r) {
+            for (uint32_t s : neighbours[rows[r]]) {
+                if (!solved[s]) bits[r * words + column[s] / 64] |= uint64_t(1) << (column[s] % 64);
+            }
+        }
+
+        vector<size_t> order(rows.size()), pivot(u, SIZE_MAX);
+        for (size_t r = 0; r < rows.size(); ++r) order[r] = r;
+        size_t rank = 0;
+        for (size_t c = 0; c < u && rank < rows.size(); ++c) {
+            const size_t word = c / 64;
+            const uint64_t bit = uint64_t(1) << (c % 64);
+            size_t pick = rank;
+            while (pick < rows.size() && (bits[order[pick] * words + word] & bit) == 0) ++pick;
+            if (pick == rows.size()) continue;
+            swap(order[rank], order[pick]);
+            // The pivot row is clear left of c, so only the words from c on change
+            const size_t p = order[rank];
+            for (size_t i = 0; i < rows.size(); ++i) {
+                const size_t r = order[i];
+                if (i == rank || (bits[r * words + word] & bit) == 0) continue;
+                for (size_t w = word; w < words; ++w) bits[r * words + w] ^= bits[p * words + w];
+                xorRegion((uint8_t *)&payloads[rows[r] * segmentLength], (const uint8_t *)&payloads[rows[p] * segmentLength],
+                          segmentLength);
+            }
+            pivot[c] = p;
+            ++rank;
+        }
+
+        // A pivot row left with its own bit alone is that segment
+        for (size_t c = 0; c < u; ++c) {
+            if (pivot[c] == SIZE_MAX) continue;
+            size_t ones = 0;
+            for (size_t w = 0; w < words; ++w) ones += __builtin_popcountll(bits[pivot[c] * words + w]);
+            if (ones != 1) continue;
+            memcpy(&record[unsolved[c] * segmentLength], &payloads[rows[pivot[c]] * segmentLength], segmentLength);
+            solved[unsolved[c]] = true;
+            ++stats.eliminated;
+        }
+    }
+
+    erasures.clear();
+    for (size_t s = 0; s < k; ++s) {
+        if (solved[s]) continue;
+        for (size_t b = 0; b < segmentLength; ++b) erasures.push_back(s * segmentLength + b);
+    }
+    return true;
+}
+
+/*
+    Reverse complement.
+
+    A sequencer reads either strand, so about half the reads of an oligo come back as the
+    reverse complement of what was written. A read is turned around when the flanks of the
+    reverse strand match it better than the forward ones: the reverse complement of the
+    trailing flank at its start, and that of the leading flank at its end. Turning a read
+    around reverses it and swaps A with T and C with G. On ASCII this is a PSHUFB byte
+    reversal plus an XOR of 0x15 (A, T) or 0x04 (C, G) picked by the low nibble of each
+    recognised base. On packed bytes, where a complement is a NOT, it is the byte reversal
+    plus a nibble lookup that reverses the order of the 2-bit pairs within each byte.
+*/
+
+struct ComplementTables {
+    char ascii[256];                // complement of each symbol, case kept, others unchanged
+    unsigned char packed[256];      // reverse complement of the 4 nucleotides in a byte
+
+    ComplementTables() {
+        for (int c = 0; c < 256; ++c) ascii[c] = (char)c;
+        const char *pairs = "ATTAaattCGGCccgg";
+        for (int i = 0; i < 16; i += 2) ascii[(unsigned char)pairs[i]] = pairs[i + 1];
+        for (int b = 0; b < 256; ++b) {
+            int reversed = 0;
+            for (int j = 0; j < 4; ++j) reversed |= ((b >> (2 * j)) & 3) << (6 - 2 * j);
+            packed[b] = (unsigned char)~reversed;
+        }
+    }
+};
+
+static const ComplementTables &complementTables() {
+    static const ComplementTables tables;
+    return tables;
+}
+
+string reverseComplementOf(const string &dnaSeq) {
+    string reversed = dnaSeq;
+    reverseComplement(&reversed[0], reversed.length());
+    return reversed;
+}
+
+#ifdef DNA_CODEC_X86
+__attribute__((target("avx2")))
+static inline __m256i reverseBytesAVX2(__m256i v) {
+    const __m256i reverse = _mm256_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0,
+                                             15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+    return _mm256_permute4x64_epi64(_mm256_shuffle_epi8(v, reverse), 0x4E);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i complementAsciiAVX2(__m256i v) {
+    const __m256i flips = _mm256_setr_epi8(0, 0x15, 0, 0x04, 0x15, 0, 0, 0x04, 0, 0, 0, 0, 0, 0, 0, 0,
+                                           0, 0x15, 0, 0x04, 0x15, 0, 0, 0x04, 0, 0, 0, 0, 0, 0, 0, 0);
+    __m256i upper = _mm256_and_si256(v, _mm256_set1_epi8((char)0xDF));
+    __m256i base = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(upper, _mm256_set1_epi8('A')),
+                                                   _mm256_cmpeq_epi8(upper, _mm256_set1_epi8('C'))),
+                                   _mm256_or_si256(_mm256_cmpeq_epi8(upper, _mm256_set1_epi8('G')),
+                                                   _mm256_cmpeq_epi8(upper, _mm256_set1_epi8('T'))));
+    __m256i flip = _mm256_shuffle_epi8(flips, _mm256_and_si256(v, _mm256_set1_epi8(0x0F)));
+    return _mm256_xor_si256(v, _mm256_and_si256(flip, base));
+}
+
+__attribute__((target("avx2")))
+static inline __m256i complementPackedAVX2(__m256i v) {
+    // Pair order within a nibble reversed, placed in the other nibble
+    const __m256i low = _mm256_setr_epi8(0x00, 0x40, (char)0x80, (char)0xC0, 0x10, 0x50, (char)0x90, (char)0xD0,
+                                         0x20, 0x60, (char)0xA0, (char)0xE0, 0x30, 0x70, (char)0xB0, (char)0xF0,
+                                         0x00, 0x40, (char)0x80, (char)0xC0, 0x10, 0x50, (char)0x90, (char)0xD0,
+                                         0x20, 0x60, (char)0xA0, (char)0xE0, 0x30, 0x70, (char)0xB0, (char)0xF0);
+    const __m256i high = _mm256_setr_epi8(0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15,
+                                          0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
+    const __m256i mask = _mm256_set1_epi8(0x0F);
+    __m256i reversed = _mm256_or_si256(_mm256_shuffle_epi8(low, _mm256_and_si256(v, mask)),
+                                       _mm256_shuffle_epi8(high, _mm256_and_si256(_mm256_srli_epi16(v, 4), mask)));
+    return _mm256_xor_si256(reversed, _mm256_set1_epi8((char)0xFF));
+}
+
+// Swap 32-byte blocks from both ends inward; returns the bytes done at each end
+template <bool packed>
+__attribute__((target("avx2")))
+static size_t reverseComplementAVX2(unsigned char *data, size_t length) {
+    size_t left = 0, right = length;
+    for (; right - left >= 64; left += 32, right -= 32) {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(data + left));
+        __m256i b = _mm256_loadu_si256((const __m256i *)(data + right - 32));
+        a = reverseBytesAVX2(packed ? complementPackedAVX2(a) : complementAsciiAVX2(a));
+        b = reverseBytesAVX2(packed ? complementPackedAVX2(b) : complementAsciiAVX2(b));
+        _mm256_storeu_si256((__m256i *)(data + left), b);
+        _mm256_storeu_si256((__m256i *)(data + right - 32), a);
+    }
+    return left;
+}
+#endif
+
+static void reverseComplementScalar(unsigned char *data, size_t left, size_t right, const unsigned char *table) {
+    for (; left < right; ++left, --right) {
+        unsigned char a = data[left];
+        data[left] = table[data[right - 1]];
+        data[right - 1] = table[a];
+    }
+}
+
+void reverseComplement(char *dnaSeq, size_t length) {
+    size_t done = 0;
+#ifdef DNA_CODEC_X86
+    if (cpuHasAVX2()) done = reverseComplementAVX2<false>((unsigned char *)dnaSeq, length);
+#endif
+    reverseComplementScalar((unsigned char *)dnaSeq, done, length - done, (const unsigned char *)complementTables().ascii);
+}
+
+void reverseComplementPacked(unsigned char *bytes, size_t length) {
+    size_t done = 0;
+#ifdef DNA_CODEC_X86
+    if (cpuHasAVX2()) done = reverseComplementAVX2<true>(bytes, length);
+#endif
+    reverseComplementScalar(bytes, done, length - done, complementTables().packed);
+}
+
+// Edit distance of a leading and a trailing flank, flankErrors + 1 for each one missing
+static size_t flankPairDistance(const char *dnaSeq, size_t length, const FlankPattern &lead, const FlankPattern &trail) {
+    size_t leadDistance, trailDistance;
+    size_t start = approximateEnd(dnaSeq, length, lead, flankErrors, &leadDistance);
+    if (start == string::npos) start = 0;
+    approximateStart(dnaSeq + start, length - start, trail, flankErrors, &trailDistance);
+    return leadDistance + trailDistance;
+}
+
+// True if a read matches the flanks of the reverse strand better than those of the forward one
+bool reverseStrand(const char *dnaSeq, size_t length, const FlankPair &flanks) {
+    const string &lead = flanks.lead.sequence, &trail = flanks.trail.sequence;
+    const string &reverseLead = flanks.reverseLead.sequence, &reverseTrail = flanks.reverseTrail.sequence;
+    if (length < lead.length() + trail.length()) return false;
+    if (memcmp(dnaSeq, lead.data(), lead.length()) == 0 &&
+        memcmp(dnaSeq + length - trail.length(), trail.data(), trail.length()) == 0) {
+        return false;
+    }
+    if (memcmp(dnaSeq, reverseLead.data(), reverseLead.length()) == 0 &&
+        memcmp(dnaSeq + length - reverseTrail.length(), reverseTrail.data(), reverseTrail.length()) == 0) {
+        return true;
+    }
+    return flankPairDistance(dnaSeq, length, flanks.reverseLead, flanks.reverseTrail) <
+           flankPairDistance(dnaSeq, length, flanks.lead, flanks.trail);
+}
+
+/*
+    Flank escaping.
+
+    With --escape-flanks 1 the payloads of -e and -i never contain the PROMOTER, TERMINATOR
+    or MARKER, so a reader finds record boundaries with one search for TERMINATOR + MARKER
+    instead of trusting lengths, and several .dna files concatenated into one stream still
+    decode. The escape is stuffing, as HDLC does with bits: whenever the output so far ends
+    with all but the last base of a flank, one base is inserted that cannot complete it, and
+    the reader drops the base at the same points. The window starts with the PROMOTER and
+    MARKER ahead of the payload, so no flank straddles its start either. That MARKER tags
+    the record as escaped: an unescaped payload starts with an encoded "FILE", "XFILE" or
+    "STRING" header.
+
+    For 8 nt flanks a base is stuffed about once per 5000, so both directions test each
+    position with AVX2 against the last four bases of every flank prefix. Only the few
+    positions that pass, and the 31 after a stuffed base while it is still in the window,
+    are checked base by base against the rolling 2-bit window.
+*/
+
+static const size_t maxStuffedRun = 32;     // consecutive stuffed bases before a flank set is deemed unescapable
+
+// Base to insert after window, -1 if none: it must not complete a flank, and should not begin another
+static int stuffedBase(const FlankEscape &escape, uint64_t window) {
+    int excluded = 0;
+    for (size_t m = 0; m < escape.count; ++m) {
+        if ((window & escape.mask[m]) == escape.prefix[m]) excluded |= 1 << escape.last[m];
+    }
+    if (excluded == 0) return -1;
+    int fallback = -1;
+    for (int code = 0; code < 4; ++code) {
+        if ((excluded >> code) & 1) continue;
+        uint64_t next = window << 2 | code;
+        bool begins = false;
+        for (size_t m = 0; m < escape.count; ++m) begins |= (next & escape.mask[m]) == escape.prefix[m];
+        if (!begins) return code;
+        if (fallback < 0) fallback = code;
+    }
+    return fallback;
+}
+
+static uint64_t packWindow(const char *dnaSeq, size_t length) {
+    const unsigned char *codes = nucleotideCodes();
+    uint64_t window = 0;
+    for (size_t i = 0; i < length; ++i) window = window << 2 | (codes[(unsigned char)dnaSeq[i]] & 3);
+    return window;
+}
+
+static bool escapeAnchorAt(const FlankEscape &escape, const char *dnaSeq, size_t position) {
+    for (size_t m = 0; m < escape.count; ++m) {
+        bool match = true;
+        for (size_t j = 0; j < 4 && match; ++j) {
+            match = escape.anchor[m][j] == 0 || dnaSeq[position - 3 + j] == escape.anchor[m][j];
+        }
+        if (match) return true;
+    }
+    return false;
+}
+
+// True if the text ending at end ends with a flank prefix; at least 31 bases must precede end
+static bool escapePrefixEnds(const FlankEscape &escape, const char *end) {
+    for (size_t m = 0; m < escape.count; ++m) {
+        if (memcmp(end - escape.prefixLength[m], escape.prefixText[m], escape.prefixLength[m]) == 0) return true;
+    }
+    return false;
+}
+
+// Positions of a stretch of text that may end a flank prefix, one bit each
+struct EscapeCandidates {
+    static const size_t chunk = 16384;
+    uint64_t bits[chunk / 64];
+    size_t begin, end;
+
+    EscapeCandidates() : begin(0), end(0) {}
+    void scan(const FlankEscape &escape, const char *text, size_t from, size_t to);
+
+    // First candidate from i on, end if none
+    size_t next(size_t i) const {
+        size_t word = (i - begin) / 64;
+        uint64_t bitsLeft = bits[word] & (~uint64_t(0) << ((i - begin) % 64));
+        while (bitsLeft == 0) {
+            if (++word * 64 >= end - begin) return end;
+            bitsLeft = bits[word];
+        }
+        return min(end, begin + word * 64 + __builtin_ctzll(bitsLeft));
+    }
+};
+
+#ifdef DNA_CODEC_X86
+// 32 positions per step against the last 4 bases of every prefix; returns the first position not done
+__attribute__((target("avx2")))
+static size_t scanEscapeCandidatesAVX2(const FlankEscape &escape, const char *text, size_t from, size_t to,
+                                       uint32_t *bits) {
+    // Wildcard anchor bases compare as always equal
+    __m256i want[3][4], any[3][4];
+    for (size_t m = 0; m < 3; ++m) {
+        for (int j = 0; j < 4; ++j) {
+            bool used = m < escape.count && escape.anchor[m][j] != 0;
+            want[m][j] = _mm256_set1_epi8(used ? escape.anchor[m][j] : 0);
+            any[m][j] = _mm256_set1_epi8(m < escape.count && !used ? -1 : 0);
+        }
+    }
+    size_t i = from;
+    for (; i + 32 <= to; i += 32) {
+        __m256i shifted[4];
+        for (int j = 0; j < 4; ++j) shifted[j] = _mm256_loadu_si256((const __m256i *)(text + i - 3 + j));
+        __m256i hits = _mm256_setzero_si256();
+        for (size_t m = 0; m < 3; ++m) {
+            __m256i hit = _mm256_or_si256(_mm256_cmpeq_epi8(shifted[0], want[m][0]), any[m][0]);
+            for (int j = 1; j < 4; ++j) {
+                hit = _mm256_and_si256(hit, _mm256_or_si256(_mm256_cmpeq_epi8(shifted[j], want[m][j]), any[m][j]));
+            }
+            hits = _mm256_or_si256(hits, hit);
+        }
+        *bits++ = (uint32_t)_mm256_movemask_epi8(hits);
+    }
+    return i;
+}
+#endif
+
+// Positions below 3 have no 4 bases before them and are always candidates
+void EscapeCandidates::scan(const FlankEscape &escape, const char *text, size_t from, size_t to) {
+    begin = from;
+    end = min(to, from + chunk);
+    memset(bits, 0, sizeof(bits));
+    size_t i = from;
+    for (; i < end && i < (from < 3 ? from + 32 : from); ++i) {
+        if (i < 3 || escapeAnchorAt(escape, text, i)) bits[(i - begin) / 64] |= uint64_t(1) << ((i - begin) % 64);
+    }
+#ifdef DNA_CODEC_X86
+    if (cpuHasAVX2()) i = scanEscapeCandidatesAVX2(escape, text, i, end, (uint32_t *)bits + (i - begin) / 32);
+#endif
+    for (; i < end; ++i) {
+        if (escapeAnchorAt(escape, text, i)) bits[(i - begin) / 64] |= uint64_t(1) << ((i - begin) % 64);
+    }
+}
+
+// Escaping state carried from block to block of one payload
+struct FlankEscaper {
+    const FlankEscape &escape;
+    uint64_t window;            // last 32 bases written, 2 bits each, newest lowest
+    size_t exact;               // bases still to check one by one, while a stuffed base may be in the window
+
+    FlankEscaper() : escape(flankSet.escape), window(packWindow((flankSet.promoter + flankSet.marker).data(),
+                                                                flankSet.promoter.length() + flankSet.marker.length())),
+                     exact(32) {}
+
+    EscapeCandidates candidates;
+
+    // Appends up to EscapeCandidates::chunk bases
+    bool append(const char *dnaSeq, size_t length, string &escaped) {
+        const unsigned char *codes = nucleotideCodes();
+        candidates.scan(escape, dnaSeq, 0, length);
+        size_t i = 0;
+        while (i < length) {
+            if (exact == 0) {
+                // Nothing stuffed in the last 32 bases: the output there is the input, so the input is searched
+                size_t next = candidates.next(i);
+                escaped.append(dnaSeq + i, min(next + 1, length) - i);
+                if (next == length) break;
+                i = next + 1;
+                if (!escapePrefixEnds(escape, escaped.data() + escaped.length())) continue;
+                window = packWindow(escaped.data() + escaped.length() - 32, 32);
+            } else {
+                char base = dnaSeq[i++];
+                escaped += base;
+                window = window << 2 | codes[(unsigned char)base];
+                --exact;
+            }
+            size_t run = 0;
+            for (int stuffed = stuffedBase(escape, window); stuffed >= 0; stuffed = stuffedBase(escape, window)) {
+                if (++run > maxStuffedRun) return false;
+                escaped += "ACGT"[stuffed];
+                window = window << 2 | stuffed;
+                exact = 32;
+            }
+        }
+        return true;
+    }
+};
+
+bool escapeFlanks(const char *dnaSeq, size_t length, string &escaped) {
+    FlankEscaper escaper;
+    escaped.reserve(escaped.length() + length + length / 1024 + 64);
+    for (size_t offset = 0; offset < length; offset += EscapeCandidates::chunk) {
+        if (!escaper.append(dnaSeq + offset, min(EscapeCandidates::chunk, length - offset), escaped)) return false;
+    }
+    return true;
+}
+
+// Bytes to escaped nucleotides, 4K at a time through the byte codec
+bool escapeFlanks(const string &bytes, string &escaped) {
+    FlankEscaper escaper;
+    char block[EscapeCandidates::chunk];
+    const size_t blockBytes = EscapeCandidates::chunk / 4;
+    escaped.reserve(escaped.length() + bytes.length() * 4 + bytes.length() / 256 + 64);
+    for (size_t offset = 0; offset < bytes.length(); offset += blockBytes) {
+        size_t count = min(blockBytes, bytes.length() - offset);
+        bytesToNucleotide((const unsigned char *)bytes.data() + offset, count, block);
+        if (!escaper.append(block, count * 4, escaped)) return false;
+    }
+    return true;
+}
+
+// Drops the stuffed bases; false if one is not where and what the escape puts it
+bool unescapeFlanks(const char *dnaSeq, size_t length, string &dnaOut) {
+    const FlankEscape &escape = flankSet.escape;
+    const unsigned char *codes = nucleotideCodes();
+    uint64_t window = packWindow((flankSet.promoter + flankSet.marker).data(),
+                                 flankSet.promoter.length() + flankSet.marker.length());
+    int stuffed = -1;
+    size_t run = 0;
+    unique_ptr<EscapeCandidates> candidates(new EscapeCandidates);
+    dnaOut.reserve(dnaOut.length() + length);
+    for (size_t i = 0; i < length; ++i) {
+        if (i >= 32 && stuffed < 0) {
+            // The window is the escaped text itself, so it is searched as is
+            if (i >= candidates->end) candidates->scan(escape, dnaSeq, i, length);
+            size_t next = candidates->next(i);
+            if (next == candidates->end && next < length) {
+                dnaOut.append(dnaSeq + i, next - i);
+                i = next - 1;
+                continue;
+            }
+            dnaOut.append(dnaSeq + i, min(next + 1, length) - i);
+            if (next == length) break;
+            i = next;
+            if (escapePrefixEnds(escape, dnaSeq + next + 1)) {
+                window = packWindow(dnaSeq + next + 1 - 32, 32);
+                stuffed = stuffedBase(escape, window);
+                run = 0;
+            }
+            continue;
+        }
+        unsigned char code = codes[(unsigned char)dnaSeq[i]];
+        if (code > 3) return false;
+        if (stuffed >= 0) {
+            if (code != stuffed || ++run > maxStuffedRun) return false;
+        } else {
+            dnaOut += dnaSeq[i];
+            run = 0;
+        }
+        window = window << 2 | code;
+        stuffed = stuffedBase(escape, window);
+    }
+    return stuffed < 0;
+}
+
+// Escaped payloads start with the MARKER
+bool escapedPayload(const char *dnaSeq, size_t length) {
+    const string &marker = flankSet.marker;
+    return length >= marker.length() && memcmp(dnaSeq, marker.data(), marker.length()) == 0;
+}
+
+#ifdef DNA_CODEC_X86
+// Candidates where the first and last bases of the flank match, 32 positions at a time
+__attribute__((target("avx2")))
+static size_t findFlankAVX2(const char *text, size_t length, const string &flank) {
+    const size_t n = flank.length();
+    const __m256i first = _mm256_set1_epi8(flank[0]), last = _mm256_set1_epi8(flank[n - 1]);
+    size_t i = 0;
+    for (; i + n - 1 + 32 <= length; i += 32) {
+        __m256i hits = _mm256_and_si256(_mm256_cmpeq_epi8(first, _mm256_loadu_si256((const __m256i *)(text + i))),
+                                        _mm256_cmpeq_epi8(last, _mm256_loadu_si256((const __m256i *)(text + i + n - 1))));
+        for (unsigned mask = (unsigned)_mm256_movemask_epi8(hits); mask != 0; mask &= mask - 1) {
+            size_t at = i + __builtin_ctz(mask);
+            if (memcmp(text + at + 1, flank.data() + 1, n - 2) == 0) return at;
+        }
+    }
+    return i;
+}
+#endif
+
+// First exact occurrence of a flank, npos if none
+size_t findFlank(const char *text, size_t length, const string &flank) {
+    const size_t n = flank.length();
+    if (length < n) return string::npos;
+    size_t i = 0;
+#ifdef DNA_CODEC_X86
+    if (cpuHasAVX2()) i = findFlankAVX2(text, length, flank);
+#endif
+    for (; i + n <= length; ++i) {
+        if (memcmp(text + i, flank.data(), n) == 0) return i;
+    }
+    return string::npos;
+}
+
+/*
+    Rotating code.
+
+    The plain mapping writes a 0x00 byte as AAAA and text as CxxA words, so runs and
+    skewed GC content follow the data, and both raise synthesis and sequencing errors. With
+    --code rotating, -e and -i payloads use Goldman's rotating ternary code instead: each
+    trit picks one of the three bases that differ from the previous base, so no base is ever
+    repeated, and any data, zeros included, comes out near 50% GC. With A, C, G, T as 0-3,
+    the base after c for trit t is c + t + 1 mod 4, which makes every base a prefix sum mod 4.
+
+    Every 3 bytes (24 bits, below 3^16) become 16 trits: the quotient and remainder by 3^8
+    index a table of the 8 prefix sums of each 8-trit group, so a block costs one multiply
+    and two lookups, with no branch. Adding the base before the group to all 8 sums at once
+    and a PSHUFB to ASCII give 16 bases. Decoding takes the differences of adjacent bases
+    back to trits, and a table maps each 8-trit group, 2 bits per trit, to its value. The
+    code carries 1.5 bits per base against 2 for the plain mapping.
+
+    A coded payload starts with the TERMINATOR and a 4-base word naming its code, written
+    with the same rule from the TERMINATOR's last base, so the tag adds no run to the flank;
+    a plain payload never starts with the TERMINATOR, nor an escaped one.
+*/
+
+static const uint32_t tritGroupValues = 6561;      // 3^8
+
+struct RotatingTables {
+    uint64_t sums[tritGroupValues];     // prefix sums of trit + 1 over each 8-trit group, one byte each, mod 4
+    uint16_t values[1 << 16];           // 8 trits at 2 bits each, first trit highest, to their value; 0xFFFF if invalid
+
+    RotatingTables() {
+        memset(values, 0xFF, sizeof(values));
+        for (uint32_t value = 0; value < tritGroupValues; ++value) {
+            uint32_t rest = value, packed = 0, sum = 0, trits[8];
+            for (int i = 7; i >= 0; --i) {
+                trits[i] = rest % 3;
+                rest /= 3;
+            }
+            sums[value] = 0;
+            for (int i = 0; i < 8; ++i) {
+                sum = (sum + trits[i] + 1) & 3;
+                sums[value] |= (uint64_t)sum << (8 * i);
+                packed = packed << 2 | trits[i];
+            }
+            values[packed] = (uint16_t)value;
+        }
+    }
+};
+
+static const RotatingTables &rotatingTables() {
+    static const RotatingTables tables;
+    return tables;
+}
+
+static inline void rotatingSums(const RotatingTables &tables, const unsigned char *bytes, unsigned char &previous,
+                                uint64_t &high, uint64_t &low) {
+    const uint64_t ones = 0x0101010101010101ULL, twoBits = 0x0303030303030303ULL;
+    uint32_t value = (uint32_t)bytes[0] << 16 | bytes[1] << 8 | bytes[2];
+    uint32_t quotient = value / tritGroupValues, remainder = value - quotient * tritGroupValues;
+    high = (tables.sums[quotient] + previous * ones) & twoBits;
+    low = (tables.sums[remainder] + (high >> 56) * ones) & twoBits;
+    previous = (unsigned char)(low >> 56);
+}
+
+#ifdef DNA_CODEC_X86
+__attribute__((target("ssse3")))
+static size_t bytesToRotatingSSSE3(const unsigned char *bytes, size_t length, char *dnaSeq, unsigned char &previous) {
+    const RotatingTables &tables = rotatingTables();
+    const __m128i symbols = _mm_setr_epi8('A', 'C', 'G', 'T', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+    size_t i = 0;
+    for (; i + 3 <= length; i += 3, dnaSeq += 16) {
+        uint64_t high, low;
+        rotatingSums(tables, bytes + i, previous, high, low);
+        __m128i codes = _mm_set_epi64x((long long)low, (long long)high);
+        _mm_storeu_si128((__m128i *)dnaSeq, _mm_shuffle_epi8(symbols, codes));
+    }
+    return i;
+}
+#endif
+
+// 16 bases per 3 bytes; length must be a multiple of 3, previous is the code of the base before
+void bytesToRotating(const unsigned char *bytes, size_t length, char *dnaSeq, unsigned char &previous) {
+    size_t i = 0;
+#ifdef DNA_CODEC_X86
+    if (cpuHasSSSE3()) i = bytesToRotatingSSSE3(bytes, length, dnaSeq, previous);
+#endif
+    const RotatingTables &tables = rotatingTables();
+    for (; i + 3 <= length; i += 3) {
+        uint64_t sums[2];
+        rotatingSums(tables, bytes + i, previous, sums[0], sums[1]);
+        for (int j = 0; j < 16; ++j) dnaSeq[i / 3 * 16 + j] = nucleotideSymbols[(sums[j / 8] >> (8 * (j % 8))) & 3];
+    }
+}
+
+static inline unsigned rotatingBlock(const RotatingTables &tables, uint32_t highTrits, uint32_t lowTrits,
+                                     unsigned char *bytes) {
+    uint32_t high = tables.values[highTrits], low = tables.values[lowTrits];
+    uint32_t value = high * tritGroupValues + low;
+    bytes[0] = (unsigned char)(value >> 16);
+    bytes[1] = (unsigned char)(value >> 8);
+    bytes[2] = (unsigned char)value;
+    return (high | low) >> 15 | (value >> 24);
+}
+
+#ifdef DNA_CODEC_X86
+// Bits 1-2 of A, C, G, T are 0, 1, 3, 2, so one PSHUFB gives the codes and another checks the symbols
+__attribute__((target("ssse3")))
+static size_t rotatingToBytesSSSE3(const char *dnaSeq, size_t length, unsigned char *bytes, unsigned char &previous,
+                                   unsigned &invalid) {
+    const RotatingTables &tables = rotatingTables();
+    const __m128i toCodes = _mm_setr_epi8(0, 1, 3, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i symbols = _mm_setr_epi8('A', 'C', 'G', 'T', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i three = _mm_set1_epi8(3), one = _mm_set1_epi8(1);
+    const __m128i pairs = _mm_set1_epi16(0x0104), nibbles = _mm_set1_epi16(0x0110), halves = _mm_set1_epi32(0x00010100);
+    __m128i before = _mm_set1_epi8((char)previous), bad = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16, bytes += 3) {
+        __m128i text = _mm_loadu_si128((const __m128i *)(dnaSeq + i));
+        __m128i codes = _mm_shuffle_epi8(toCodes, _mm_and_si128(_mm_srli_epi16(text, 1), three));
+        bad = _mm_or_si128(bad, _mm_xor_si128(text, _mm_shuffle_epi8(symbols, codes)));
+        // trit = code - previous code - 1, where 3 marks a repeated base
+        __m128i trits = _mm_and_si128(_mm_sub_epi8(_mm_sub_epi8(codes, _mm_alignr_epi8(codes, before, 15)), one), three);
+        bad = _mm_or_si128(bad, _mm_cmpeq_epi8(trits, three));
+        before = codes;
+        // 2-bit trits to nibbles, bytes, then one 16-bit group index per 32-bit lane
+        __m128i packed = _mm_maddubs_epi16(trits, pairs);
+        packed = _mm_maddubs_epi16(_mm_packus_epi16(packed, packed), nibbles);
+        packed = _mm_madd_epi16(packed, halves);
+        invalid |= rotatingBlock(tables, (uint32_t)_mm_cvtsi128_si32(packed),
+                                 (uint32_t)_mm_cvtsi128_si32(_mm_srli_si128(packed, 4)), bytes);
+    }
+    if (i > 0) previous = (unsigned char)(_mm_extract_epi16(before, 7) >> 8);
+    invalid |= _mm_movemask_epi8(_mm_cmpeq_epi8(bad, _mm_setzero_si128())) != 0xFFFF;
+    return i;
+}
+#endif
+
+// Inverse of bytesToRotating; false on a repeated base, a symbol other than ACGT or a block out of range
+bool rotatingToBytes(const char *dnaSeq, size_t length, unsigned char *bytes, unsigned char &previous) {
+    const RotatingTables &tables = rotatingTables();
+    const unsigned char *codes = nucleotideCodes();
+    if (length % 16 != 0) return false;
+    unsigned invalid = 0;
+    size_t i = 0;
+#ifdef DNA_CODEC_X86
+    if (cpuHasSSSE3()) {
+        i = rotatingToBytesSSSE3(dnaSeq, length, bytes, previous, invalid);
+        bytes += i / 16 * 3;
+    }
+#endif
+    for (; i < length; i += 16, bytes += 3) {
+        uint32_t groups[2] = {0, 0};
+        for (int j = 0; j < 16; ++j) {
+            unsigned char code = codes[(unsigned char)dnaSeq[i + j]];
+            unsigned trit = (code - previous - 1) & 3;
+            invalid |= (code >> 2) | (trit == 3);
+            groups[j / 8] = groups[j / 8] << 2 | trit;
+            previous = code & 3;
+        }
+        invalid |= rotatingBlock(tables, groups[0], groups[1], bytes);
+    }
+    return invalid == 0;
+}
+
+/*
+    Sense codon code.
+
+    With --code sense, -e and -i payloads are written in the 61 sense codons only, so read in
+    frame from its first base the payload holds no TAA, TAG or TGA and can be expressed. Every
+    2 bytes are one value below 61^3 and become 3 base-61 digits, each a sense codon: 9 bases
+    per 16 bits, 1.78 bits per base against 2 for the plain mapping, or 12.5% more bases.
+
+    Both directions are table lookups, with no multiply or divide: a 64K table gives the three
+    codons of each 2-byte block, and decoding indexes the codons with the SSSE3 kernel of
+    --codons and adds the place value of each from three tables, in which a stop codon or
+    another symbol weighs more than any valid block. The blocks are
+    independent, so long payloads are split across threads. The payload starts on a codon
+    boundary counted from the end of the PROMOTER, after the tag and up to two C filler bases.
+*/
+
+static const uint32_t senseDigits = 61;
+static const uint32_t senseInvalid = 1 << 24;       // place value of a stop codon, above any block
+
+struct SenseTables {
+    uint32_t codons[1 << 16];       // three codon indices of each block, 6 bits each, first highest
+    char bases[64][4];              // bases of each codon index, 16 * first + 4 * second + third base code
+    uint32_t places[3][65];         // value of each codon index as the first, second and third digit, 64 for
+                                    // a codon with another symbol
+
+    SenseTables() {
+        unsigned char sense[senseDigits];
+        uint32_t digits = 0;
+        for (uint32_t codon = 0; codon < 64; ++codon) {
+            bases[codon][0] = nucleotideSymbols[codon >> 4];
+            bases[codon][1] = nucleotideSymbols[(codon >> 2) & 3];
+            bases[codon][2] = nucleotideSymbols[codon & 3];
+            bases[codon][3] = 0;
+            bool stop = codon == 48 || codon == 50 || codon == 56;      // TAA, TAG, TGA
+            for (int place = 0; place < 3; ++place) {
+                places[place][codon] = stop ? senseInvalid : digits * (place == 0 ? senseDigits * senseDigits : place == 1 ? senseDigits : 1);
+            }
+            if (!stop) sense[digits++] = (unsigned char)codon;
+        }
+        for (int place = 0; place < 3; ++place) places[place][64] = senseInvalid;
+        for (uint32_t value = 0; value < (1 << 16); ++value) {
+            codons[value] = (uint32_t)sense[value / (senseDigits * senseDigits)] << 12 |
+                            (uint32_t)sense[value / senseDigits % senseDigits] << 6 | sense[value % senseDigits];
+        }
+    }
+};
+
+static const SenseTables &senseTables() {
+    static const SenseTables tables;
+    return tables;
+}
+
+// 9 bases per 2 bytes; length must be even
+void bytesToSense(const unsigned char *bytes, size_t length, char *dnaSeq) {
+    const SenseTables &tables = senseTables();
+    parallelFor((length / 2 + 65535) / 65536, [&](size_t first, size_t last) {
+        for (size_t i = first * 131072; i < min(length, last * 131072); i += 2) {
+            uint32_t codons = tables.codons[bytes[i] << 8 | bytes[i + 1]];
+            char *out = dnaSeq + i / 2 * 9;
+            memcpy(out, tables.bases[codons >> 12], 3);
+            memcpy(out + 3, tables.bases[(codons >> 6) & 63], 3);
+            memcpy(out + 6, tables.bases[codons & 63], 3);
+        }
+    });
+}
+
+// Inverse of bytesToSense; false on a stop codon, a symbol other than ACGT or a block out of range
+bool senseToBytes(const char *dnaSeq, size_t length, unsigned char *bytes) {
+    const SenseTables &tables = senseTables();
+    if (length % 9 != 0) return false;
+    size_t blocks = length / 9;
+    atomic<bool> valid(true);
+    parallelFor((blocks + 65535) / 65536, [&](size_t first, size_t last) {
+        vector<unsigned char> indices(3 * 65536);
+        uint32_t invalid = 0;
+        for (size_t chunk = first; chunk < last; ++chunk) {
+            size_t begin = chunk * 65536, count = min<size_t>(65536, blocks - begin);
+            codonIndices(dnaSeq + 9 * begin, 3 * count, indices.data());
+            for (size_t b = 0; b < count; ++b) {
+                const unsigned char *codons = &indices[3 * b];
+                uint32_t value = tables.places[0][codons[0]] + tables.places[1][codons[1]] + tables.places[2][codons[2]];
+                invalid |= value >> 16;
+                bytes[2 * (begin + b)] = (unsigned char)(value >> 8);
+                bytes[2 * (begin + b) + 1] = (unsigned char)value;
+            }
+        }
+        if (invalid != 0) valid = false;
+    });
+    return valid;
+}
+
+/*
+    Payload codes.
+*/
+
+// The code as 4 base-3 digits, most significant first, each base one of the three that differ from the one before
+static void codeWord(int code, char previous, char *word) {
+    unsigned base = nucleotideCodes()[(unsigned char)previous];
+    for (int i = 0; i < 4; ++i) {
+        int digit = code / (i == 0 ? 27 : i == 1 ? 9 : i == 2 ? 3 : 1) % 3;
+        base = (base + 1 + digit) & 3;
+        word[i] = nucleotideSymbols[base];
+    }
+}
+
+// Code held in a code word, -1 if the 4 bases are not one
+static int readCodeWord(const char *word, char previous) {
+    const unsigned char *codes = nucleotideCodes();
+    unsigned base = codes[(unsigned char)previous];
+    int code = 0;
+    for (int i = 0; i < 4; ++i) {
+        unsigned next = codes[(unsigned char)word[i]];
+        unsigned digit = (next - base - 1) & 3;
+        if (next > 3 || digit == 3) return -1;
+        code = code * 3 + digit;
+        base = next;
+    }
+    return code;
+}
+
+// TERMINATOR, then the code word, which repeats no base, then C's up to the next codon boundary for the sense code
+string payloadCodeTag(int code) {
+    string tag = flankSet.terminator + string(4, 'A');
+    codeWord(code, flankSet.terminator.back(), &tag[flankSet.terminator.length()]);
+    if (code == senseCode) tag.append((3 - tag.length() % 3) % 3, 'C');
+    return tag;
+}
+
+// Code a payload is tagged with, plainCode and a tag length of 0 if untagged
+int taggedPayloadCode(const char *dnaSeq, size_t length, size_t &tagLength) {
+    const string &terminator = flankSet.terminator;
+    tagLength = 0;
+    if (length < terminator.length() + 4 || memcmp(dnaSeq, terminator.data(), terminator.length()) != 0) return plainCode;
+    int code = readCodeWord(dnaSeq + terminator.length(), terminator.back());
+    if (code < 0) return -1;
+    tagLength = code == senseCode ? payloadCodeTag(code).length() : terminator.length() + 4;
+    return tagLength <= length ? code : -1;
+}
+
+// Appends bytes, a multiple of 3, in the code set by --code
+void encodePayload(const string &bytes, string &dnaSeq) {
+    if (codecOptions.payloadCode == plainCode) {
+        dnaSeq += bytesToNucleotide(bytes);
+        return;
+    }
+    string tag = payloadCodeTag(codecOptions.payloadCode);
+    size_t start = dnaSeq.length() + tag.length();
+    dnaSeq += tag;
+    if (codecOptions.payloadCode == senseCode) {
+        // Whole 2-byte blocks, the odd byte padded with a NUL the record length leaves out
+        string blocks = bytes + string(bytes.length() % 2, '\0');
+        dnaSeq.resize(start + blocks.length() / 2 * 9);
+        bytesToSense((const unsigned char *)blocks.data(), blocks.length(), &dnaSeq[start]);
+        return;
+    }
+    unsigned char previous = nucleotideCodes()[(unsigned char)tag.back()];
+    dnaSeq.resize(start + bytes.length() / 3 * 16);
+    bytesToRotating((const unsigned char *)bytes.data(), bytes.length(), &dnaSeq[start], previous);
+}
+
+bool decodePayload(const char *dnaSeq, size_t length, string &bytes) {
+    size_t tagLength;
+    int code = taggedPayloadCode(dnaSeq, length, tagLength);
+    if (code == plainCode && tagLength == 0) return nucleotideToBytes(dnaSeq, length, bytes);
+    if (code == senseCode && (length - tagLength) % 9 == 0) {
+        bytes.resize((length - tagLength) / 9 * 2);
+        return senseToBytes(dnaSeq + tagLength, length - tagLength, (unsigned char *)&bytes[0]);
+    }
+    if (code != rotatingCode || (length - tagLength) % 16 != 0) return false;
+    unsigned char previous = nucleotideCodes()[(unsigned char)dnaSeq[tagLength - 1]];
+    bytes.resize((length - tagLength) / 16 * 3);
+    return rotatingToBytes(dnaSeq + tagLength, length - tagLength, (unsigned char *)&bytes[0], previous);
+}
+
+/*
+    Oligo reassembly.
+
+    Sequencing returns the oligos in any order and with duplicates. Each read is decoded on
+    its own, checked against its CRC, and its stripe is copied straight to its slot in the
+    OligoStore; the first valid copy of an index wins. Slots live in chunks of 64K
+    allocated on first use, so memory follows the number of distinct oligos, never the
+    number of reads: read sets far larger than RAM stream through with no sort and no spill.
+*/
+
+static const size_t oligoFlankMismatches = 2;      // substitutions tolerated across both flanks
+
+static size_t flankMismatches(const char *dnaSeq, const char *flank, size_t length) {
+    size_t mismatches = 0;
+    for (size_t i = 0; i < length; ++i) mismatches += dnaSeq[i] != flank[i];
+    return mismatches;
+}
+
+// Strip the flanks and pack the payload, turning a read of the reverse strand around; the CRC is not checked yet
+static bool readOligoBytes(const char *dnaSeq, size_t length, unsigned char *bytes, size_t &byteCount,
+                           bool &reversed) {
+    const FlankPair &flanks = flankSet.oligo;
+    const size_t promoter = flanks.lead.sequence.length(), terminator = flanks.trail.sequence.length();
+    if (length < promoter + terminator + 4 * (oligoAddressBytes + 1 + oligoChecksumBytes) ||
+        (length - promoter - terminator) % 4 != 0) {
+        return false;
+    }
+    byteCount = (length - promoter - terminator) / 4;
+    if (byteCount > oligoMaxBytes) return false;
+    reversed = flankMismatches(dnaSeq, flanks.lead.sequence.data(), promoter) +
+               flankMismatches(dnaSeq + length - terminator, flanks.trail.sequence.data(), terminator) > oligoFlankMismatches;
+    if (reversed && flankMismatches(dnaSeq, flanks.reverseLead.sequence.data(), terminator) +
+                    flankMismatches(dnaSeq + length - promoter, flanks.reverseTrail.sequence.data(), promoter) >
+                    oligoFlankMismatches) {
+        return false;
+    }
+    if (!nucleotideToBytes(dnaSeq + (reversed ? terminator : promoter), length - promoter - terminator, bytes)) {
+        return false;
+    }
+    if (reversed) reverseComplementPacked(bytes, byteCount);
+    return true;
+}
+
+// The index as written, with the seed mask of fountain droplets taken off
+static uint32_t unmaskIndex(uint32_t index, uint8_t layoutByte) {
+    return layoutByte == fountainLayoutByte ? index ^ fountainSeedMask : index;
+}
+
+static uint32_t oligoIndex(const unsigned char *bytes) {
+    return unmaskIndex(((uint32_t)bytes[0] << 24) | (bytes[1] << 16) | (bytes[2] << 8) | bytes[3], bytes[4]);
+}
+
+static bool unpackOligo(const unsigned char *bytes, size_t byteCount, uint32_t &index, uint8_t &layoutByte, string &stripe) {
+    size_t payloadEnd = byteCount - oligoChecksumBytes;
+    if (crc16(bytes, payloadEnd) != ((bytes[payloadEnd] << 8) | bytes[payloadEnd + 1])) return false;
+
+    index = oligoIndex(bytes);
+    layoutByte = bytes[4];
+    stripe.assign((const char *)bytes + oligoAddressBytes, payloadEnd - oligoAddressBytes);
+    return true;
+}
+
+bool decodeOligo(const char *dnaSeq, size_t length, uint32_t &index, uint8_t &layoutByte, string &stripe) {
+    unsigned char bytes[oligoMaxBytes];
+    size_t byteCount;
+    bool reversed;
+    return readOligoBytes(dnaSeq, length, bytes, byteCount, reversed) && unpackOligo(bytes, byteCount, index, layoutByte, stripe);
+}
+
+struct OligoStore {
+    static const size_t chunkBits = 16;
+    static const size_t chunkSlots = size_t(1) << chunkBits;
+
+    struct Chunk {
+        vector<char> data;
+        atomic<uint8_t> seen[chunkSlots];
+    };
+
+    unique_ptr<atomic<Chunk *>[]> chunks;
+    mutex allocation;
+    atomic<uint64_t> shape;     // stripe length << 8 | layout byte of the first valid oligo, 0 until then
+    atomic<size_t> unique;
+    atomic<uint64_t> highest;   // highest index placed
+
+    OligoStore() : chunks(new atomic<Chunk *>[(size_t(1) << 32) >> chunkBits]()), shape(0), unique(0), highest(0) {}
+
+    ~OligoStore() {
+        for (size_t c = 0; c < (size_t(1) << 32) >> chunkBits; ++c) delete chunks[c].load();
+    }
+
+    OligoLayout layout() const {
+        uint64_t s = shape.load();
+        OligoLayout layout;
+        layout.stripeLength = s >> 8;
+        layout.parityStripes = (s >> 4) & 15;
+        layout.groupStripes = ((s & 15) + 1) * 8;
+        layout.fountain = (s & 0xFF) == fountainLayoutByte;
+        return layout;
+    }
+
+    bool contains(uint32_t index) const {
+        const Chunk *chunk = chunks[index >> chunkBits].load();
+        return chunk != nullptr && chunk->seen[index & (chunkSlots - 1)].load() != 0;
+    }
+
+    // False for an oligo whose shape disagrees with the first one seen
+    bool place(uint32_t index, uint8_t layoutByte, const string &stripe) {
+        uint64_t key = ((uint64_t)stripe.length() << 8) | layoutByte, expected = 0;
+        if (!shape.compare_exchange_strong(expected, key) && expected != key) return false;
+
+        size_t c = index >> chunkBits, slot = index & (chunkSlots - 1);
+        Chunk *chunk = chunks[c].load();
+        if (chunk == nullptr) {
+            lock_guard<mutex> lock(allocation);
+            chunk = chunks[c].load();
+            if (chunk == nullptr) {
+                chunk = new Chunk();
+                chunk->data.resize(chunkSlots * stripe.length());
+                chunks[c].store(chunk);
+            }
+        }
+        if (chunk->seen[slot].exchange(1) == 0) {
+            memcpy(&chunk->data[slot * stripe.length()], stripe.data(), stripe.length());
+            ++unique;
+            uint64_t high = highest.load();
+            while (index > high && !highest.compare_exchange_weak(high, index)) {}
+        }
+        return true;
+    }
+
+    // Contiguous stripes up to the highest index, completed to whole erasure groups
+    void assemble(string &stripes, vector<bool> &present) const {
+        OligoLayout shape = layout();
+        size_t count = highest.load() + 1;
+        if (shape.parityStripes > 0) {
+            size_t stride = shape.groupStripes + shape.parityStripes;
+            count = (count + stride - 1) / stride * stride;
+        }
+
+        stripes.assign(count * shape.stripeLength, '\0');
+        present.assign(count, false);
+        for (size_t i = 0; i < count; ++i) {
+            const Chunk *chunk = chunks[i >> chunkBits].load();
+            size_t slot = i & (chunkSlots - 1);
+            if (chunk == nullptr || chunk->seen[slot].load() == 0) continue;
+            memcpy(&stripes[i * shape.stripeLength], &chunk->data[slot * shape.stripeLength], shape.stripeLength);
+            present[i] = true;
+        }
+    }
+};
+
+/*
+    Consensus
+    A read that parses but fails its CRC is kept, packed, under the index it claims. Once
+    every shard is read, each index still missing is voted on position by position across
+    its damaged copies, and the winner goes back through the CRC like any other read.
+
+    The vote is bit-sliced: 16 bytes of a copy split into high and low bit planes of 64
+    nucleotides, each base's indicator word is added into eight-plane counters with a
+    ripple carry, and two rounds of bit-sliced compares (A/C, G/T, then the winners) pick
+    the most frequent base of all 64 positions at once. Ties go to the earlier base.
+    Indices are sharded across threads, so no two threads vote on the same oligo.
+
+    When any copy comes from FASTQ the vote is soft instead. Each base adds its log
+    likelihood ratio, 10 * log10(3 (1 - e) / e) for Phred error rate e, to its symbol's
+    score, 16 positions per AVX2 step, and the highest score wins. A winner that still
+    fails the CRC is not thrown away when the file has no oligo parity: if its address
+    bytes are confident, bases winning by softErasureMargin or more, it is placed unverified.
+    Any of its bytes may be wrong, so the whole stripe goes to the Reed-Solomon decoder as
+    erasures, and only when the record header, read from verified oligos, names an --rs code.
+*/
+
+static const size_t consensusMaxCopies = 255;   // eight-plane counters
+
+struct ConsensusTables {
+    uint8_t hi[256], lo[256];   // high and low bits of each byte's four nucleotides, first nucleotide lowest
+    uint8_t pack[256];          // high nibble << 4 | low nibble back to a byte
+
+    ConsensusTables() {
+        for (int b = 0; b < 256; ++b) {
+            hi[b] = lo[b] = 0;
+            for (int j = 0; j < 4; ++j) {
+                int symbol = (b >> (6 - 2 * j)) & 3;
+                hi[b] |= (symbol >> 1) << j;
+                lo[b] |= (symbol & 1) << j;
+            }
+            pack[b] = 0;
+            for (int j = 0; j < 4; ++j) {
+                pack[b] |= (((b >> (4 + j)) & 1) << (7 - 2 * j)) | (((b >> j) & 1) << (6 - 2 * j));
+            }
+        }
+    }
+};
+
+static const ConsensusTables &consensusTables() {
+    static const ConsensusTables tables;
+    return tables;
+}
+
+// Lanes where bit-sliced counter a exceeds b
+static uint64_t slicedGreater(const uint64_t *a, const uint64_t *b) {
+    uint64_t greater = 0, equal = ~uint64_t(0);
+    for (int i = 7; i >= 0; --i) {
+        greater |= equal & a[i] & ~b[i];
+        equal &= ~(a[i] ^ b[i]);
+    }
+    return greater;
+}
+
+static void slicedSelect(uint64_t mask, const uint64_t *a, const uint64_t *b, uint64_t *out) {
+    for (int i = 0; i < 8; ++i) out[i] = (a[i] & mask) | (b[i] & ~mask);
+}
+
+// Per-position majority of packed copies of one oligo
+static void consensusOligo(const vector<const unsigned char *> &copies, size_t byteCount, unsigned char *out) {
+    const ConsensusTables &tables = consensusTables();
+    size_t copyCount = min(copies.size(), consensusMaxCopies);
+    for (size_t w = 0; w < byteCount; w += 16) {
+        size_t n = min<size_t>(16, byteCount - w);
+        uint64_t count[4][8] = {};
+        for (size_t c = 0; c < copyCount; ++c) {
+            const unsigned char *copy = copies[c] + w;
+            uint64_t h = 0, l = 0;
+            for (size_t k = 0; k < n; ++k) {
+                h |= (uint64_t)tables.hi[copy[k]] << (4 * k);
+                l |= (uint64_t)tables.lo[copy[k]] << (4 * k);
+            }
+            const uint64_t symbol[4] = {~h & ~l, ~h & l, h & ~l, h & l};
+            for (int s = 0; s < 4; ++s) {
+                uint64_t carry = symbol[s];
+                for (int i = 0; carry != 0 && i < 8; ++i) {
+                    uint64_t next = count[s][i] & carry;
+                    count[s][i] ^= carry;
+                    carry = next;
+                }
+            }
+        }
+
+        uint64_t cWins = slicedGreater(count[1], count[0]), tWins = slicedGreater(count[3], count[2]);
+        uint64_t ac[8], gt[8];
+        slicedSelect(cWins, count[1], count[0], ac);
+        slicedSelect(tWins, count[3], count[2], gt);
+        uint64_t h = slicedGreater(gt, ac), l = (tWins & h) | (cWins & ~h);
+        for (size_t k = 0; k < n; ++k) {
+            out[w + k] = tables.pack[(((h >> (4 * k)) & 15) << 4) | ((l >> (4 * k)) & 15)];
+        }
+    }
+}
+
+static const int fastaPhred = 20;          // assumed quality of FASTA copies in a soft vote
+static const int softErasureMargin = 20;   // winning margin, in Phred units, below which a base is unreliable
+
+struct SoftTables {
+    uint8_t weights[94];        // log likelihood ratio of a base at each Phred score
+    uint8_t codes[256][4];      // nucleotides of each packed byte
+
+    SoftTables() {
+        for (int q = 0; q < 94; ++q) {
+            double e = pow(10.0, -q / 10.0);
+            weights[q] = q == 0 ? 0 : (uint8_t)max(0.0, floor(10 * log10(3 * (1 - e) / e) + 0.5));
+        }
+        for (int b = 0; b < 256; ++b) {
+            for (int j = 0; j < 4; ++j) codes[b][j] = (b >> (6 - 2 * j)) & 3;
+        }
+    }
+};
+
+static const SoftTables &softTables() {
+    static const SoftTables tables;
+    return tables;
+}
+
+#ifdef DNA_CODEC_X86
+__attribute__((target("avx2")))
+static size_t softAccumulateAVX2(uint16_t *const scores[4], const uint8_t *codes, const uint8_t *weights, size_t length) {
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        __m256i c = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(codes + i)));
+        __m256i w = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(weights + i)));
+        for (int s = 0; s < 4; ++s) {
+            __m256i hit = _mm256_and_si256(_mm256_cmpeq_epi16(c, _mm256_set1_epi16(s)), w);
+            __m256i score = _mm256_loadu_si256((const __m256i *)(scores[s] + i));
+            _mm256_storeu_si256((__m256i *)(scores[s] + i), _mm256_adds_epu16(score, hit));
+        }
+    }
+    return i;
+}
+#endif
+
+#ifdef DNA_CODEC_X86
+__attribute__((target("avx2")))
+static size_t softDecideAVX2(uint16_t *const scores[4], uint8_t *codes, uint8_t *weak, size_t length) {
+    const __m256i margin = _mm256_set1_epi16(softErasureMargin);
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(scores[0] + i));
+        __m256i c = _mm256_loadu_si256((const __m256i *)(scores[1] + i));
+        __m256i g = _mm256_loadu_si256((const __m256i *)(scores[2] + i));
+        __m256i t = _mm256_loadu_si256((const __m256i *)(scores[3] + i));
+        __m256i p = _mm256_max_epu16(a, c), q = _mm256_min_epu16(a, c);
+        __m256i r = _mm256_max_epu16(g, t), u = _mm256_min_epu16(g, t);
+        __m256i best = _mm256_max_epu16(p, r);
+        __m256i second = _mm256_max_epu16(_mm256_min_epu16(p, r), _mm256_max_epu16(q, u));
+
+        // First symbol reaching the maximum: 3 - (number of earlier-or-equal symbols tied at it)
+        __m256i symbol = _mm256_set1_epi16(3);
+        symbol = _mm256_add_epi16(symbol, _mm256_cmpeq_epi16(g, best));
+        symbol = _mm256_blendv_epi8(symbol, _mm256_set1_epi16(1), _mm256_cmpeq_epi16(c, best));
+        symbol = _mm256_blendv_epi8(symbol, _mm256_setzero_si256(), _mm256_cmpeq_epi16(a, best));
+        __m256i low = _mm256_cmpgt_epi16(margin, _mm256_sub_epi16(best, second));
+
+        __m128i s8 = _mm_packus_epi16(_mm256_castsi256_si128(symbol), _mm256_extracti128_si256(symbol, 1));
+        __m128i w8 = _mm_packs_epi16(_mm256_castsi256_si128(low), _mm256_extracti128_si256(low, 1));
+        _mm_storeu_si128((__m128i *)(codes + i), s8);
+        _mm_storeu_si128((__m128i *)(weak + i), w8);
+    }
+    return i;
+}
+#endif
+
+// Winning symbol of each position, and whether it won by less than softErasureMargin
+static void softDecide(uint16_t *const scores[4], uint8_t *codes, uint8_t *weak, size_t length) {
+    size_t i = 0;
+#ifdef DNA_CODEC_X86
+    if (cpuHasAVX2()) i = softDecideAVX2(scores, codes, weak, length);
+#endif
+    for (; i < length; ++i) {
+        int best = 0, runnerUp = 0;
+        for (int s = 1; s < 4; ++s) {
+            if (scores[s][i] > scores[best][i]) best = s;
+        }
+        for (int s = 0; s < 4; ++s) {
+            if (s != best) runnerUp = max<int>(runnerUp, scores[s][i]);
+        }
+        codes[i] = best;
+        weak[i] = scores[best][i] - runnerUp < softErasureMargin;
+    }
+}
+
+// scores[codes[i]][i] += weights[i] for one copy
+static void softAccumulate(uint16_t *const scores[4], const uint8_t *codes, const uint8_t *weights, size_t length) {
+    size_t i = 0;
+#ifdef DNA_CODEC_X86
+    if (cpuHasAVX2()) i = softAccumulateAVX2(scores, codes, weights, length);
+#endif
+    for (; i < length; ++i) {
+        uint16_t &score = scores[codes[i]][i];
+        score = min(65535, score + weights[i]);
+    }
+}
+
+/*
+    Indel realignment
+    An insertion or deletion shifts every later base out of its 4-nucleotide frame, so a
+    read whose length is off cannot be packed at all. Such a read is kept base by base:
+    its flanks are found by approximate search (Myers' bit-vector algorithm, one word for
+    an 8 nt flank), and the payload between them is aligned to the vote of its index
+    group with Myers' algorithm over the reference, 64 rows per word, in a band of
+    maxIndels around the diagonal. The traceback projects the read onto the reference:
+    inserted bases are dropped and deleted ones cast no vote, so the realigned copy joins
+    the soft vote in frame. Groups without a copy of the right length are drafted from
+    their shifted copies and polished. Reads with an indel inside the address land in
+    the wrong group until clustering moves them back.
+*/
+
+static const size_t maxIndels = 16;     // largest length difference realigned, and the band half-width
+
+// Payload between approximately matched flanks, for reads the fixed frame rejects: adapter bases, indels
+static bool locateOligoPayload(const char *dnaSeq, size_t length, size_t &start, size_t &payloadLength) {
+    const FlankPair &flanks = flankSet.oligo;
+    if (length < flanks.lead.sequence.length() + flanks.trail.sequence.length() +
+                 4 * (oligoAddressBytes + 1 + oligoChecksumBytes)) {
+        return false;
+    }
+
+    start = approximateEnd(dnaSeq, length, flanks.lead, flankErrors);
+    if (start == string::npos) return false;
+    payloadLength = approximateStart(dnaSeq + start, length - start, flanks.trail, flankErrors);
+    return payloadLength != string::npos && payloadLength >= 4 * (oligoAddressBytes + 1 + oligoChecksumBytes) &&
+           payloadLength <= oligoMaxBytes * 4 + maxIndels;
+}
+
+struct Aligner {
+    struct Column {
+        uint64_t pv, mv;        // vertical deltas of rows top + 1 .. top + 64
+        uint64_t ph, mh;        // horizontal deltas into this column of the previous column's rows
+        long bottom;            // score of row top + 64
+        size_t top;
+    };
+
+    // D[i][j] - D[i - 1][j] and D[i][j] - D[i][j - 1], for rows in the band
+    static int vertical(const Column &column, size_t i) {
+        size_t bit = i - column.top - 1;
+        return int((column.pv >> bit) & 1) - int((column.mv >> bit) & 1);
+    }
+
+    static int horizontal(const Column &column, const Column &previous, size_t i) {
+        size_t bit = i - previous.top - 1;
+        return int((column.ph >> bit) & 1) - int((column.mh >> bit) & 1);
+    }
+
+    vector<uint64_t> peq;       // 4 x words match masks of the reference, one spare word
+    vector<Column> columns;     // state after each read base, columns[0] before any
+    size_t words;
+
+    static const long unreachable = 1L << 30;
+
+    // 64 match bits of symbol c from reference position p on
+    uint64_t window(int c, size_t p) const {
+        const uint64_t *mask = &peq[c * words];
+        size_t w = p / 64, shift = p % 64;
+        return shift == 0 ? mask[w] : (mask[w] >> shift) | (mask[w + 1] << (64 - shift));
+    }
+
+    // D[i][j]: edit distance of reference[0, i) and read[0, j), unreachable outside the band
+    long cell(size_t i, size_t j) const {
+        if (j == 0) return i;
+        if (i == 0) return j;
+        const Column &column = columns[j];
+        if (i <= column.top || i > column.top + 64) return unreachable;
+        size_t shift = i - column.top;
+        if (shift == 64) return column.bottom;
+        return column.bottom - __builtin_popcountll(column.pv >> shift) + __builtin_popcountll(column.mv >> shift);
+    }
+
+    // Project read onto reference coordinates: bases the read lacks get weight 0 and deleted set,
+    // inserted[i] is the first base inserted before reference position i, 4 for none (m + 1 entries).
+    // Returns the edit distance, npos when it exceeds maxEdits or the lengths differ by more than maxIndels.
+    size_t project(const uint8_t *reference, size_t m, const uint8_t *read, const uint8_t *readWeights, size_t n,
+                   size_t maxEdits, uint8_t *codes, uint8_t *weights, uint8_t *deleted, uint8_t *inserted) {
+        if (m == 0 || n == 0 || (m > n ? m - n : n - m) > maxIndels) return string::npos;
+        words = (m + 64) / 64 + 1;
+        peq.assign(4 * words, 0);
+        for (size_t i = 0; i < m; ++i) peq[reference[i] * words + i / 64] |= uint64_t(1) << (i % 64);
+
+        // The band's top row trails the diagonal by slack, so it drops one row per base once past it
+        size_t difference = m > n ? m - n : n - m;
+        size_t slack = (63 - difference) / 2 + (n > m ? difference : 0);
+        columns.resize(n + 1);
+        uint64_t pv = ~uint64_t(0), mv = 0;
+        long bottom = 64;
+        size_t top = 0;
+        columns[0].pv = pv;
+        columns[0].mv = mv;
+        columns[0].bottom = bottom;
+        columns[0].top = top;
+        for (size_t j = 1; j <= n; ++j) {
+            int c = read[j - 1];
+            uint64_t ph, mh;
+            int h = myersStep(pv, mv, window(c, top), 1, uint64_t(1) << 63, ph, mh);
+            bottom += h;
+            if (j > slack) {
+                // The new bottom row has no cell below it in the band: its delta follows from the row above
+                size_t row = top + 65;
+                int cost = row > m || reference[row - 1] != c;
+                int v = min(cost - h, 1);
+                pv = (pv >> 1) | (uint64_t(v > 0) << 63);
+                mv = (mv >> 1) | (uint64_t(v < 0) << 63);
+                bottom += v;
+                ++top;
+            }
+            Column &column = columns[j];
+            column.pv = pv;
+            column.mv = mv;
+            column.ph = ph;
+            column.mh = mh;
+            column.bottom = bottom;
+            column.top = top;
+        }
+
+        long distance = cell(m, n);
+        if (distance >= unreachable || (size_t)distance > maxEdits) return string::npos;
+
+        memset(deleted, 0, m);
+        memset(inserted, 4, m + 1);
+        // Walk back through the stored deltas; neighbours outside the band are unreachable
+        size_t i = m, j = n;
+        long score = distance;
+        while (i > 0 || j > 0) {
+            // A matching base on the diagonal is always an optimal step
+            if (i > 1 && j > 1 && reference[i - 1] == read[j - 1] && i - 1 > columns[j - 1].top &&
+                i <= columns[j - 1].top + 64) {
+                codes[i - 1] = read[j - 1];
+                weights[i - 1] = readWeights[j - 1];
+                score -= horizontal(columns[j], columns[j - 1], i) + vertical(columns[j - 1], i);
+                --i;
+                --j;
+                continue;
+            }
+            long diagonal = unreachable, up = unreachable, left = unreachable, leftScore = 0;
+            if (i == 1 || (i > 1 && j == 0)) up = (long)j + i;
+            else if (i > 1 && i - 1 > columns[j].top) up = score - vertical(columns[j], i) + 1;
+            if (j > 0 && (i == 0 || (i > columns[j - 1].top && i <= columns[j - 1].top + 64))) {
+                leftScore = i == 0 ? (long)j - 1 : score - horizontal(columns[j], columns[j - 1], i);
+                left = leftScore + 1;
+                if (i == 1) diagonal = (long)j - 1 + (reference[0] != read[j - 1]);
+                else if (i > 1 && i - 1 > columns[j - 1].top) {
+                    diagonal = leftScore - vertical(columns[j - 1], i) + (reference[i - 1] != read[j - 1]);
+                }
+            }
+            if (diagonal <= up && diagonal <= left) {
+                codes[i - 1] = read[j - 1];
+                weights[i - 1] = readWeights[j - 1];
+                score = diagonal - (reference[i - 1] != read[j - 1]);
+                --i;
+                --j;
+            } else if (up <= left) {
+                codes[i - 1] = reference[i - 1];
+                weights[i - 1] = 0;
+                deleted[--i] = 1;
+                score = up - 1;
+            } else {
+                inserted[i] = read[--j];    // walking backwards, the last write is the first base
+                score = leftScore;
+            }
+        }
+        return distance;
+    }
+};
+
+struct DamagedRead {
+    size_t offset;              // packed bytes in DamagedOligos::bytes, or codes in DamagedOligos::shifted
+    size_t length;              // bytes when packed, nucleotides when shifted
+    size_t quality;             // one Phred score per payload base in DamagedOligos::quality, npos for FASTA
+    bool shifted;
+};
+
+struct DamagedOligos {
+    string bytes;               // packed reads back to back
+    string shifted;             // 0-3 codes of reads out of frame, back to back
+    string quality;             // Phred scores of FASTQ reads and of every shifted read, back to back
+    vector<DamagedRead> reads;
+};
+
+struct DamagedCopy {
+    uint32_t index;
+    const unsigned char *bytes;     // packed, or nullptr for a shifted read
+    const uint8_t *codes;           // shifted read codes
+    size_t length;                  // nucleotides
+    const uint8_t *quality;         // nullptr for FASTA
+
+    bool operator<(const DamagedCopy &other) const { return index < other.index; }
+};
+
+struct UnverifiedOligo {
+    uint32_t index;
+    size_t copies;
+};
+
+// Running quality-weighted vote over copies of one oligo
+struct SoftVote {
+    static const size_t maxLength = oligoMaxBytes * 4 + maxIndels;
+
+    size_t length;              // nucleotides
+    size_t copies;
+    uint16_t scores[4][maxLength];
+
+    void reset(size_t nucleotides) {
+        length = nucleotides;
+        copies = 0;
+        for (int s = 0; s < 4; ++s) memset(scores[s], 0, length * sizeof(uint16_t));
+    }
+
+    void addCodes(const uint8_t *codes, const uint8_t *weights) {
+        if (copies == consensusMaxCopies) return;
+        uint16_t *const planes[4] = {scores[0], scores[1], scores[2], scores[3]};
+        softAccumulate(planes, codes, weights, length);
+        ++copies;
+    }
+
+    void addPacked(const unsigned char *bytes, const uint8_t *quality) {
+        const SoftTables &tables = softTables();
+        uint8_t codes[oligoMaxBytes * 4], weights[oligoMaxBytes * 4];
+        for (size_t j = 0; j < length / 4; ++j) memcpy(&codes[j * 4], tables.codes[bytes[j]], 4);
+        if (quality != nullptr) {
+            for (size_t i = 0; i < length; ++i) weights[i] = tables.weights[quality[i]];
+        } else {
+            memset(weights, tables.weights[fastaPhred], length);
+        }
+        addCodes(codes, weights);
+    }
+
+    void call(uint8_t *codes, uint8_t *low) {
+        uint16_t *const planes[4] = {scores[0], scores[1], scores[2], scores[3]};
+        softDecide(planes, codes, low, length);
+    }
+
+    // Winning bases packed into out, and the bytes holding a base that won narrowly
+    void decide(unsigned char *out, vector<bool> &weak) {
+        uint8_t codes[maxLength], low[maxLength];
+        call(codes, low);
+        packVote(codes, low, length, out, weak);
+    }
+
+    static void packVote(const uint8_t *codes, const uint8_t *low, size_t length, unsigned char *out, vector<bool> &weak) {
+        weak.assign(length / 4, false);
+        for (size_t j = 0; j < length / 4; ++j) {
+            const uint8_t *c = &codes[j * 4], *w = &low[j * 4];
+            out[j] = (c[0] << 6) | (c[1] << 4) | (c[2] << 2) | c[3];
+            weak[j] = (w[0] | w[1] | w[2] | w[3]) != 0;
+        }
+    }
+};
+
+// Quality-weighted vote of packed copies
+static void softConsensusOligo(const vector<DamagedCopy> &copies, size_t byteCount, unsigned char *out,
+                               vector<bool> &weak) {
+    unique_ptr<SoftVote> vote(new SoftVote);
+    vote->reset(byteCount * 4);
+    for (const DamagedCopy &copy : copies) vote->addPacked(copy.bytes, copy.quality);
+    vote->decide(out, weak);
+}
+
+struct PolishSpace {
+    vector<uint8_t> draft, next, codes, weights, deleted, inserted, called, low;
+    vector<uint16_t> gaps, inserts, insertScores;
+};
+
+static const int polishRounds = 3;
+
+/*
+    Draft polishing for a group with shifted copies: every copy is aligned to the draft,
+    its bases vote per position, and a majority of copies missing a base or inserting one
+    before it edits the draft. The draft starts from the in-frame vote if one is given,
+    else from the shifted copy nearest the expected length. Fills consensus and weak once
+    the draft has the expected length.
+*/
+static bool polishConsensus(const vector<DamagedCopy> &group, const unsigned char *inFrame, size_t length,
+                            SoftVote &vote, Aligner &aligner, PolishSpace &space,
+                            unsigned char *consensus, vector<bool> &weak) {
+    const SoftTables &tables = softTables();
+    if (inFrame != nullptr) {
+        space.draft.resize(length);
+        for (size_t k = 0; k < length / 4; ++k) memcpy(&space.draft[k * 4], tables.codes[inFrame[k]], 4);
+    } else {
+        const DamagedCopy *nearest = nullptr;
+        for (const DamagedCopy &copy : group) {
+            if (copy.bytes != nullptr) continue;
+            size_t distance = copy.length > length ? copy.length - length : length - copy.length;
+            if (nearest == nullptr || distance < (nearest->length > length ? nearest->length - length : length - nearest->length)) {
+                nearest = &copy;
+            }
+        }
+        if (nearest == nullptr) return false;
+        space.draft.assign(nearest->codes, nearest->codes + nearest->length);
+    }
+
+    for (int round = 0; ; ++round) {
+        size_t m = space.draft.size();
+        vote.reset(m);
+        space.codes.resize(SoftVote::maxLength);
+        space.weights.resize(SoftVote::maxLength);
+        space.deleted.resize(m);
+        space.inserted.resize(m + 1);
+        space.gaps.assign(m, 0);
+        space.inserts.assign(m + 1, 0);
+        space.insertScores.assign(4 * (m + 1), 0);
+
+        for (const DamagedCopy &copy : group) {
+            const uint8_t *read = copy.codes, *quality = copy.quality;
+            size_t n = copy.length;
+            uint8_t unpacked[oligoMaxBytes * 4], readWeights[SoftVote::maxLength];
+            if (copy.bytes != nullptr) {
+                n = length;
+                for (size_t k = 0; k < n / 4; ++k) memcpy(&unpacked[k * 4], tables.codes[copy.bytes[k]], 4);
+                read = unpacked;
+            }
+            for (size_t k = 0; k < n; ++k) readWeights[k] = tables.weights[quality != nullptr ? quality[k] : fastaPhred];
+            if (aligner.project(space.draft.data(), m, read, readWeights, n, m / 4, space.codes.data(),
+                                space.weights.data(), space.deleted.data(), space.inserted.data()) == string::npos) {
+                continue;
+            }
+            vote.addCodes(space.codes.data(), space.weights.data());
+            for (size_t i = 0; i < m; ++i) space.gaps[i] += space.deleted[i];
+            for (size_t i = 0; i <= m; ++i) {
+                if (space.inserted[i] == 4) continue;
+                ++space.inserts[i];
+                space.insertScores[space.inserted[i] * (m + 1) + i] += 1;
+            }
+        }
+        if (vote.copies == 0) return false;
+
+        space.called.resize(m);
+        space.low.resize(m);
+        vote.call(space.called.data(), space.low.data());
+        space.next.clear();
+        bool edited = false;
+        for (size_t i = 0; i <= m; ++i) {
+            if (space.inserts[i] * 2 > vote.copies) {
+                int best = 0;
+                for (int b = 1; b < 4; ++b) {
+                    if (space.insertScores[b * (m + 1) + i] > space.insertScores[best * (m + 1) + i]) best = b;
+                }
+                space.next.push_back(best);
+                edited = true;
+            }
+            if (i == m) break;
+            if (space.gaps[i] * 2 > vote.copies) edited = true;
+            else space.next.push_back(space.called[i]);
+        }
+        if (!edited && m != length) {
+            // The draft is the wrong length but no edit has a majority: take the best supported one toward the
+            // expected length, as copies can place an indel at either end of a repeat
+            size_t best = 0;
+            if (m < length) {
+                for (size_t i = 1; i <= m; ++i) best = space.inserts[i] > space.inserts[best] ? i : best;
+                if (space.inserts[best] >= 2) {
+                    int base = 0;
+                    for (int b = 1; b < 4; ++b) {
+                        if (space.insertScores[b * (m + 1) + best] > space.insertScores[base * (m + 1) + best]) base = b;
+                    }
+                    space.next.assign(space.called.begin(), space.called.end());
+                    space.next.insert(space.next.begin() + best, (uint8_t)base);
+                    edited = true;
+                }
+            } else {
+                for (size_t i = 1; i < m; ++i) best = space.gaps[i] > space.gaps[best] ? i : best;
+                if (space.gaps[best] >= 2) {
+                    space.next.assign(space.called.begin(), space.called.end());
+                    space.next.erase(space.next.begin() + best);
+                    edited = true;
+                }
+            }
+        }
+        if (!edited || round == polishRounds || space.next.size() > SoftVote::maxLength) break;
+        space.draft.swap(space.next);
+    }
+
+    if (space.draft.size() != length) return false;
+    SoftVote::packVote(space.called.data(), space.low.data(), length, consensus, weak);
+    return true;
+}
+
+/*
+    Read clustering
+    A damaged read whose index bytes are hit is filed under an index no other copy claims,
+    and its copies vote without it. Reads are regrouped by content instead: the stripe of
+    each read is sketched by its (w, k) minimizers, k-mers packed 2 bits per base as they
+    roll past and hashed with an invertible mix, of which the smallest few are kept. Every
+    sketch hash is claimed in a shared open-addressed table, and a read that finds its hash
+    already claimed is united with the claimer in a lock-free union-find. Within a cluster,
+    a read whose index no other member shares moves to the shared index whose copies have
+    most of its minimizers, so a cluster that merged several oligos of similar content does
+    not pull reads into the wrong one.
+
+    The union-find, the table and the sort that groups the clusters fit in --cluster-memory;
+    the more reads there are, the fewer hashes each read keeps in the table.
+*/
+
+static const size_t minimizerK = 24;            // nucleotides per k-mer, 48 bits before hashing
+static const size_t minimizerWindow = 8;        // k-mers per minimizer window
+static const size_t sketchMaxHashes = 8;        // table entries per read when memory allows
+static const size_t clusterCandidates = 8;      // shared indices a stray read is compared with
+static const size_t clusterRepresentatives = 3; // copies of a shared index it is compared with
+
+// Invertible on 64 bits, so distinct k-mers keep distinct hashes
+static inline uint64_t mixHash(uint64_t x) {
+    x *= 0x9E3779B97F4A7C15ULL;
+    return x ^ (x >> 29);
+}
+
+// The smallest keep distinct minimizer hashes of a read's stripe, sorted; the address bytes are mostly shared
+// by every oligo
+static void readMinimizers(const DamagedCopy &copy, size_t length, vector<uint64_t> &hashes, size_t keep = SIZE_MAX) {
+    const uint64_t mask = (uint64_t(1) << (2 * minimizerK)) - 1;
+    const size_t first = oligoAddressBytes * 4, end = copy.bytes != nullptr ? length : copy.length;
+    uint8_t unpacked[oligoMaxBytes * 4];
+    const uint8_t *codes = copy.codes;
+    if (copy.bytes != nullptr) {
+        const SoftTables &tables = softTables();
+        for (size_t b = 0; b < length / 4; ++b) memcpy(unpacked + 4 * b, tables.codes[copy.bytes[b]], 4);
+        codes = unpacked;
+    }
+    uint64_t kmer = 0, window[minimizerWindow], least = ~uint64_t(0), last = 0;
+    size_t leastAt = 0;
+    hashes.clear();
+    for (size_t i = first; i < end; ++i) {
+        kmer = ((kmer << 2) | codes[i]) & mask;
+        if (i + 1 < first + minimizerK) continue;
+        size_t k = i + 1 - first - minimizerK;      // k-mers before this one
+        uint64_t hash = mixHash(kmer);
+        window[k % minimizerWindow] = hash;
+        if (hash <= least) {
+            least = hash;
+            leastAt = k;
+        } else if (leastAt + minimizerWindow == k) {
+            // The minimum left the window: rescan it
+            least = ~uint64_t(0);
+            for (size_t w = k + 1 - minimizerWindow; w <= k; ++w) {
+                if (window[w % minimizerWindow] <= least) {
+                    least = window[w % minimizerWindow];
+                    leastAt = w;
+                }
+            }
+        }
+        if (k + 1 < minimizerWindow || least == last || least == 0) continue;  // 0 is the poly-A k-mer
+        last = least;
+        if (keep > sketchMaxHashes) {
+            hashes.push_back(least);
+            continue;
+        }
+        // A short sketch stays sorted as it goes
+        if (hashes.size() == keep && least >= hashes.back()) continue;
+        size_t at = lower_bound(hashes.begin(), hashes.end(), least) - hashes.begin();
+        if (at < hashes.size() && hashes[at] == least) continue;
+        if (hashes.size() == keep) hashes.pop_back();
+        hashes.insert(hashes.begin() + at, least);
+    }
+    if (keep > sketchMaxHashes) {
+        sort(hashes.begin(), hashes.end());
+        hashes.erase(unique(hashes.begin(), hashes.end()), hashes.end());
+    }
+}
+
+// Roots link to the smaller read, so a parent is always a smaller read and halving needs no lock
+struct ClusterForest {
+    vector<atomic<uint32_t>> parent;
+
+    explicit ClusterForest(size_t reads) : parent(reads) {
+        for (size_t r = 0; r < reads; ++r) parent[r].store((uint32_t)r, memory_order_relaxed);
+    }
+
+    uint32_t find(uint32_t read) {
+        for (;;) {
+            uint32_t up = parent[read].load(memory_order_acquire);
+            if (up == read) return read;
+            uint32_t next = parent[up].load(memory_order_acquire);
+            if (next != up) parent[read].compare_exchange_weak(up, next, memory_order_acq_rel);
+            read = next;
+        }
+    }
+
+    void unite(uint32_t a, uint32_t b) {
+        for (;;) {
+            a = find(a);
+            b = find(b);
+            if (a == b) return;
+            if (a < b) swap(a, b);
+            uint32_t root = a;
+            if (parent[a].compare_exchange_strong(root, b, memory_order_acq_rel)) return;
+        }
+    }
+};
+
+// Open-addressed hash set whose first claimer of each hash is recorded; 0 marks an empty slot
+struct MinimizerTable {
+    struct Slot {
+        atomic<uint64_t> hash;
+        atomic<uint32_t> owner;     // claiming read + 1, 0 until published
+    };
+    unique_ptr<Slot[]> slots;
+    size_t mask;
+
+    explicit MinimizerTable(size_t count) : slots(new Slot[count]), mask(count - 1) {
+        for (size_t i = 0; i < count; ++i) {
+            slots[i].hash.store(0, memory_order_relaxed);
+            slots[i].owner.store(0, memory_order_relaxed);
+        }
+    }
+
+    void prefetch(uint64_t hash) const { __builtin_prefetch(&slots[(hash >> 20) & mask], 1); }
+
+    // Returns the read that claimed hash first, or read itself if it is first or the table is full
+    uint32_t claim(uint64_t hash, uint32_t read) {
+        for (size_t i = (hash >> 20) & mask, probes = 0; probes <= mask; i = (i + 1) & mask, ++probes) {
+            Slot &slot = slots[i];
+            uint64_t held = slot.hash.load(memory_order_acquire);
+            if (held == 0 && slot.hash.compare_exchange_strong(held, hash, memory_order_acq_rel)) {
+                slot.owner.store(read + 1, memory_order_release);
+                return read;
+            }
+            if (held == hash) {
+                uint32_t owner;
+                while ((owner = slot.owner.load(memory_order_acquire)) == 0) this_thread::yield();
+                return owner - 1;
+            }
+        }
+        return read;
+    }
+};
+
+struct ClusterMember {
+    uint32_t root, index, read;
+    bool operator<(const ClusterMember &other) const {
+        return root != other.root ? root < other.root : index != other.index ? index < other.index : read < other.read;
+    }
+};
+
+// Move reads filed under an index of their own to the index their content matches; returns the number moved
+static size_t clusterDamagedCopies(vector<DamagedCopy> &copies, size_t length, size_t memoryBudget) {
+    const size_t reads = copies.size();
+    const size_t perRead = sizeof(uint32_t) + sizeof(ClusterMember);
+    const size_t perSlot = sizeof(MinimizerTable::Slot);
+    if (reads < 3) return 0;
+
+    // At most half the table is used, whatever each read keeps
+    size_t slots = 1;
+    while (reads * perRead < memoryBudget && slots < 2 * reads * sketchMaxHashes &&
+           slots * 2 * perSlot <= memoryBudget - reads * perRead) {
+        slots *= 2;
+    }
+    const size_t sketchSize = min(sketchMaxHashes, slots / 2 / reads);
+    if (reads >= UINT32_MAX || sketchSize == 0) {
+        cerr << "Not clustering " << reads << " damaged reads in " << (memoryBudget >> 20)
+             << " MiB, raise --cluster-memory" << endl;
+        return 0;
+    }
+
+    ClusterForest forest(reads);
+    {
+        MinimizerTable table(slots);
+        parallelFor(reads, [&](size_t begin, size_t end) {
+            vector<uint64_t> hashes;
+            for (size_t r = begin; r < end; ++r) {
+                readMinimizers(copies[r], length, hashes, sketchSize);
+                for (uint64_t hash : hashes) table.prefetch(hash);
+                uint32_t united = (uint32_t)r;
+                for (uint64_t hash : hashes) {
+                    uint32_t owner = table.claim(hash, (uint32_t)r);
+                    if (owner != united) forest.unite((uint32_t)r, united = owner);
+                }
+            }
+        });
+    }
+
+    vector<ClusterMember> members(reads);
+    for (size_t r = 0; r < reads; ++r) members[r] = {forest.find((uint32_t)r), copies[r].index, (uint32_t)r};
+    sort(members.begin(), members.end());
+    vector<size_t> clusters;
+    for (size_t i = 0; i < reads; ++i) {
+        if (i == 0 || members[i].root != members[i - 1].root) clusters.push_back(i);
+    }
+    clusters.push_back(reads);
+
+    atomic<size_t> moved(0);
+    parallelFor(clusters.size() - 1, [&](size_t begin, size_t end) {
+        vector<pair<size_t, size_t>> shared;     // (copies, first member) of each index claimed more than once
+        vector<size_t> strays;
+        vector<vector<uint64_t>> sharedHashes;
+        vector<uint64_t> hashes, stray;
+        for (size_t c = begin; c < end; ++c) {
+            shared.clear();
+            strays.clear();
+            for (size_t i = clusters[c], j; i < clusters[c + 1]; i = j) {
+                for (j = i; j < clusters[c + 1] && members[j].index == members[i].index; ++j) {}
+                if (j - i == 1) strays.push_back(i);
+                else shared.push_back(make_pair(j - i, i));
+            }
+            if (strays.empty() || shared.empty()) continue;
+            sort(shared.rbegin(), shared.rend());
+            if (shared.size() > clusterCandidates) shared.resize(clusterCandidates);
+
+            sharedHashes.resize(max(sharedHashes.size(), shared.size()));
+            for (size_t s = 0; s < shared.size(); ++s) {
+                sharedHashes[s].clear();
+                for (size_t k = 0; k < min(shared[s].first, clusterRepresentatives); ++k) {
+                    readMinimizers(copies[members[shared[s].second + k].read], length, hashes);
+                    sharedHashes[s].insert(sharedHashes[s].end(), hashes.begin(), hashes.end());
+                }
+                sort(sharedHashes[s].begin(), sharedHashes[s].end());
+            }
+
+            // A stray must share a quarter of its minimizers with the copies it joins
+            for (size_t i : strays) {
+                readMinimizers(copies[members[i].read], length, stray);
+                size_t best = 0, target = 0;
+                for (size_t s = 0; s < shared.size(); ++s) {
+                    size_t common = 0;
+                    for (uint64_t hash : stray) common += binary_search(sharedHashes[s].begin(), sharedHashes[s].end(), hash);
+                    if (common > best) {
+                        best = common;
+                        target = s;
+                    }
+                }
+                if (best == 0 || best * 4 < stray.size()) continue;
+                copies[members[i].read].index = members[shared[target].second].index;
+                ++moved;
+            }
+        }
+    });
+    return moved;
+}
+
+// Vote on every index the store is still missing; returns the number recovered
+static size_t recoverByConsensus(OligoStore &store, const vector<DamagedOligos> &damaged,
+                                 vector<UnverifiedOligo> &unverified, size_t &clustered) {
+    // Damaged reads must agree with the valid ones on length, else with each other
+    size_t byteCount = 0;
+    if (store.shape.load() != 0) {
+        byteCount = oligoAddressBytes + store.layout().stripeLength + oligoChecksumBytes;
+    } else {
+        unordered_map<size_t, size_t> lengths;
+        size_t best = 0;
+        for (const DamagedOligos &d : damaged) {
+            for (const DamagedRead &read : d.reads) {
+                if (read.shifted && read.length % 4 != 0) continue;
+                size_t bytes = read.shifted ? read.length / 4 : read.length;
+                size_t votes = ++lengths[bytes];
+                if (votes > best || (votes == best && bytes < byteCount)) {
+                    best = votes;
+                    byteCount = bytes;
+                }
+            }
+        }
+    }
+    const size_t length = byteCount * 4;
+
+    vector<DamagedCopy> all;
+    for (const DamagedOligos &d : damaged) {
+        for (const DamagedRead &read : d.reads) {
+            DamagedCopy copy;
+            copy.quality = read.quality == string::npos ? nullptr : (const uint8_t *)d.quality.data() + read.quality;
+            if (!read.shifted) {
+                if (read.length != byteCount) continue;
+                copy.bytes = (const unsigned char *)d.bytes.data() + read.offset;
+                copy.codes = nullptr;
+                copy.length = length;
+                copy.index = oligoIndex(copy.bytes);
+            } else {
+                if (read.length + maxIndels < length || read.length > length + maxIndels) continue;
+                copy.bytes = nullptr;
+                copy.codes = (const uint8_t *)d.shifted.data() + read.offset;
+                copy.length = read.length;
+                // Filed like its in-frame copies, so a droplet's seed mask comes off too
+                uint32_t index = 0;
+                uint8_t layoutByte = 0;
+                for (int i = 0; i < 16; ++i) index = (index << 2) | copy.codes[i];
+                for (int i = 16; i < 20; ++i) layoutByte = (uint8_t)((layoutByte << 2) | copy.codes[i]);
+                copy.index = unmaskIndex(index, layoutByte);
+            }
+            all.push_back(copy);
+        }
+    }
+
+    // Reads filed under a damaged index go back to their copies before the vote
+    clustered = clusterDamagedCopies(all, length, (size_t)codecOptions.clusterMemory << 20);
+    size_t shards = max(1u, thread::hardware_concurrency());
+    vector<vector<DamagedCopy>> sharded(shards);
+    for (const DamagedCopy &copy : all) {
+        if (!store.contains(copy.index)) sharded[copy.index % shards].push_back(copy);
+    }
+    vector<DamagedCopy>().swap(all);
+
+    // Unverified oligos only make sense beside verified ones, without oligo parity and outside a fountain
+    uint64_t shape = store.shape.load();
+    bool keepUnverified = shape != 0 && ((shape >> 4) & 15) == 0 && (shape & 255) != fountainLayoutByte;
+    atomic<size_t> recovered(0);
+    mutex unverifiedLock;
+    parallelFor(shards, [&](size_t begin, size_t end) {
+        const SoftTables &tables = softTables();
+        unique_ptr<SoftVote> vote(new SoftVote);
+        Aligner aligner;
+        PolishSpace polish;
+        vector<DamagedCopy> group;
+        vector<const unsigned char *> copies;
+        vector<bool> weak;
+        vector<uint8_t> weights(length);
+        unsigned char consensus[oligoMaxBytes];
+        string stripe;
+        for (size_t s = begin; s < end; ++s) {
+            vector<DamagedCopy> &reads = sharded[s];
+            stable_sort(reads.begin(), reads.end());
+            for (size_t i = 0, j; i < reads.size(); i = j) {
+                bool soft = false, realign = false;
+                for (j = i; j < reads.size() && reads[j].index == reads[i].index; ++j) {
+                    soft |= reads[j].quality != nullptr;
+                    realign |= reads[j].bytes == nullptr && reads[j].length != length;
+                }
+                group.assign(reads.begin() + i, reads.begin() + j);
+
+                uint32_t index;
+                uint8_t layoutByte;
+                if (!soft) {
+                    if (group.size() < 2) continue;
+                    copies.clear();
+                    for (const DamagedCopy &copy : group) copies.push_back(copy.bytes);
+                    consensusOligo(copies, byteCount, consensus);
+                } else {
+                    // In-frame copies vote first; shifted ones only if that vote fails
+                    vote->reset(length);
+                    for (const DamagedCopy &copy : group) {
+                        if (copy.bytes != nullptr) {
+                            vote->addPacked(copy.bytes, copy.quality);
+                        } else if (copy.length == length) {
+                            for (size_t k = 0; k < length; ++k) weights[k] = tables.weights[copy.quality[k]];
+                            vote->addCodes(copy.codes, weights.data());
+                        }
+                    }
+                    size_t inFrame = vote->copies;
+                    if (inFrame > 0) vote->decide(consensus, weak);
+                    // In-frame copies may hide an insertion and a deletion, so a draft from their vote can be
+                    // off; the second draft starts from a shifted copy instead
+                    if (realign && (inFrame == 0 || !unpackOligo(consensus, byteCount, index, layoutByte, stripe))) {
+                        bool verified = inFrame > 0 &&
+                                        polishConsensus(group, consensus, length, *vote, aligner, polish, consensus, weak) &&
+                                        unpackOligo(consensus, byteCount, index, layoutByte, stripe);
+                        if (!verified && !polishConsensus(group, nullptr, length, *vote, aligner, polish, consensus, weak)) {
+                            continue;
+                        }
+                    }
+                }
+                if (unpackOligo(consensus, byteCount, index, layoutByte, stripe)) {
+                    if (store.place(index, layoutByte, stripe)) ++recovered;
+                    continue;
+                }
+                // With indels in the group, a vote that fails its CRC may have a shifted stretch that still looks confident
+                if (!soft || realign || !keepUnverified || consensus[4] != (shape & 255) ||
+                    find(weak.begin(), weak.begin() + oligoAddressBytes, true) != weak.begin() + oligoAddressBytes) {
+                    continue;
+                }
+
+                lock_guard<mutex> lock(unverifiedLock);
+                unverified.push_back(UnverifiedOligo{oligoIndex(consensus), group.size()});
+            }
+        }
+    });
+    return recovered;
+}
+
+// Whether the XFILE header of the record is whole in the verified stripes at its start and names an --rs code
+static bool verifiedHeaderHasRS(const string &stripes, const vector<bool> &present, size_t stripeLength) {
+    size_t verified = 0;
+    while (verified < present.size() && present[verified]) ++verified;
+    string prefix = stripes.substr(0, verified * stripeLength);
+    if (prefix.rfind("XFILE:", 0) != 0) return false;
+    size_t nameEnd = prefix.find(':', 6);
+    size_t sizeEnd = nameEnd == string::npos ? string::npos : prefix.find(':', nameEnd + 1);
+    size_t optionsEnd = sizeEnd == string::npos ? string::npos : prefix.find(':', sizeEnd + 1);
+    CodecOptions options;
+    return optionsEnd != string::npos && parseRecordOptions(prefix.substr(sizeEnd + 1, optionsEnd - sizeEnd - 1), options) &&
+           options.rsParity > 0;
+}
+
+// Read every shard in parallel into one store and lay the stripes out by index
+bool collectOligos(const vector<string> &readFiles, OligoLayout &layout, string &stripes, vector<bool> &present,
+                   vector<size_t> &erasures, OligoReadStats &stats) {
+    OligoStore store;
+    atomic<size_t> reads(0), invalid(0), shifted(0), reversed(0);
+    atomic<bool> unreadable(false);
+    vector<DamagedOligos> damaged;
+    mutex damagedLock;
+
+    parallelFor(readFiles.size(), [&](size_t begin, size_t end) {
+        DamagedOligos local;
+        unsigned char bytes[oligoMaxBytes];
+        string stripe, turned, turnedQuality;
+        const size_t promoter = flankSet.promoter.length();
+        for (size_t f = begin; f < end; ++f) {
+            bool opened = forEachSequence(readFiles[f], [&](const SequenceRecord &read) {
+                uint32_t index;
+                uint8_t layoutByte;
+                size_t byteCount;
+                bool hasQuality = read.quality != nullptr && read.qualityLength == read.length;
+                size_t start, payloadLength;
+                bool reverseRead;
+                ++reads;
+                if (!readOligoBytes(read.sequence, read.length, bytes, byteCount, reverseRead)) {
+                    // A read of the reverse strand is turned around, quality included
+                    const char *sequence = read.sequence, *quality = read.quality;
+                    if (reverseStrand(read.sequence, read.length, flankSet.oligo)) {
+                        turned.assign(read.sequence, read.length);
+                        reverseComplement(&turned[0], read.length);
+                        sequence = turned.data();
+                        if (hasQuality) {
+                            turnedQuality.assign(read.quality, read.length);
+                            reverse(turnedQuality.begin(), turnedQuality.end());
+                            quality = turnedQuality.data();
+                        }
+                        ++reversed;
+                    }
+                    if (!locateOligoPayload(sequence, read.length, start, payloadLength)) {
+                        ++invalid;
+                        return;
+                    }
+                    // Adapter bases trimmed, the payload may still be in frame
+                    if (payloadLength % 4 == 0 && payloadLength / 4 <= oligoMaxBytes &&
+                        nucleotideToBytes(sequence + start, payloadLength, bytes) &&
+                        unpackOligo(bytes, payloadLength / 4, index, layoutByte, stripe)) {
+                        if (!store.place(index, layoutByte, stripe)) ++invalid;
+                        return;
+                    }
+                    // Out of frame: keep the payload base by base, N and other symbols at quality 0
+                    DamagedRead damagedRead = {local.shifted.length(), payloadLength, local.quality.length(), true};
+                    const unsigned char *codes = nucleotideCodes();
+                    for (size_t i = start; i < start + payloadLength; ++i) {
+                        unsigned char code = codes[(unsigned char)sequence[i]];
+                        int phred = code > 3 ? 0 : hasQuality ? min(93, max(0, quality[i] - 33)) : fastaPhred;
+                        local.shifted += (char)(code & 3);
+                        local.quality += (char)phred;
+                    }
+                    local.reads.push_back(damagedRead);
+                    ++shifted;
+                    return;
+                }
+                if (reverseRead) ++reversed;
+                if (!unpackOligo(bytes, byteCount, index, layoutByte, stripe)) {
+                    DamagedRead damagedRead = {local.bytes.length(), byteCount, string::npos, false};
+                    if (hasQuality) {
+                        damagedRead.quality = local.quality.length();
+                        for (size_t i = 0; i < byteCount * 4; ++i) {
+                            size_t at = reverseRead ? read.length - promoter - 1 - i : promoter + i;
+                            local.quality += (char)min(93, max(0, read.quality[at] - 33));
+                        }
+                    }
+                    local.reads.push_back(damagedRead);
+                    local.bytes.append((const char *)bytes, byteCount);
+                } else if (!store.place(index, layoutByte, stripe)) {
+                    ++invalid;
+                }
+            });
+            if (!opened) {
+                cerr << "Could not open file: " << readFiles[f] << endl;
+                unreadable = true;
+            }
+        }
+        lock_guard<mutex> lock(damagedLock);
+        damaged.push_back(move(local));
+    });
+    if (unreadable) return false;
+
+    vector<UnverifiedOligo> unverified;
+    stats.damaged = 0;
+    for (const DamagedOligos &d : damaged) stats.damaged += d.reads.size();
+    stats.clustered = 0;
+    stats.consensus = stats.damaged > 0 ? recoverByConsensus(store, damaged, unverified, stats.clustered) : 0;
+    if (store.unique == 0) {
+        cerr << "No valid oligos found." << endl;
+        return false;
+    }
+
+    stats.reads = reads;
+    stats.unique = store.unique;
+    stats.invalid = invalid;
+    stats.shifted = shifted;
+    stats.reversed = reversed;
+    layout = store.layout();
+    store.assemble(stripes, present);
+
+    // Unverified stripes fill only gaps below the highest verified index, and only in a record the
+    // outer code protects; a lone read with a damaged address must not stretch or overwrite the record
+    stats.unverified = 0;
+    erasures.clear();
+    if (unverified.empty() || !verifiedHeaderHasRS(stripes, present, layout.stripeLength)) return true;
+    for (const UnverifiedOligo &oligo : unverified) {
+        if (oligo.index >= present.size() || present[oligo.index]) continue;
+        present[oligo.index] = true;
+        ++stats.unverified;
+        for (size_t b = 0; b < layout.stripeLength; ++b) erasures.push_back(oligo.index * layout.stripeLength + b);
+    }
+    return true;
+}
+
+string formatIndexRanges(const vector<size_t> &indices, size_t maxRanges) {
+    string ranges;
+    size_t count = 0;
+    for (size_t i = 0; i < indices.size(); ++count) {
+        if (count == maxRanges) return ranges + ", ...";
+        size_t j = i;
+        while (j + 1 < indices.size() && indices[j + 1] == indices[j] + 1) ++j;
+        if (!ranges.empty()) ranges += ", ";
+        ranges += to_string(indices[i]);
+        if (j > i) ranges += "-" + to_string(indices[j]);
+        i = j + 1;
+    }
+    return ranges;
+}
+
+/*
+    FASTA/FASTQ reading.
+
+    Regular files are mapped and every record is handed out as views into the mapping, so a
+    read costs no copy and no allocation; pipes and other unmappable inputs are read in 4 MB
+    chunks with the unfinished record carried over. Line ends are found with memchr, which
+    glibc vectorizes, and a trailing '\r' is dropped from each line. Only sequences or
+    qualities wrapped over several lines are joined, into buffers reused from read to read.
+*/
+
+struct SequenceReader {
+    int fd;
+    const char *data;
+    size_t size, pos;
+    bool mapped, atEof;
+    string buffer, joinedSequence, joinedQuality;
+
+    SequenceReader() : fd(-1), data(nullptr), size(0), pos(0), mapped(false), atEof(false) {}
+
+    ~SequenceReader() {
+        if (mapped) munmap((void *)data, size);
+        if (fd >= 0) close(fd);
+    }
+
+    bool open(const string &fileName) {
+        fd = ::open(fileName.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+
+        struct stat info;
+        if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode)) {
+            if (info.st_size == 0) {
+                atEof = true;
+                return true;
+            }
+            void *mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapping != MAP_FAILED) {
+                madvise(mapping, info.st_size, MADV_SEQUENTIAL);
+                data = (const char *)mapping;
+                size = info.st_size;
+                mapped = atEof = true;
+            }
+        }
+        return true;
+    }
+
+    // Views stay valid until the next call
+    bool next(SequenceRecord &record) {
+        for (;;) {
+            size_t consumed = 0;
+            int status = parseRecord(data + pos, data + size, record, consumed);
+            if (status > 0) {
+                pos += consumed;
+                return true;
+            }
+            if (status < 0 || atEof) return false;
+            refill();
+        }
+    }
+
+private:
+    void refill() {
+        const size_t chunk = 4 << 20;
+        buffer.erase(0, pos);
+        size_t kept = buffer.length();
+        buffer.resize(kept + chunk);
+        ssize_t n = read(fd, &buffer[kept], chunk);
+        buffer.resize(kept + max<ssize_t>(n, 0));
+        if (n <= 0) atEof = true;
+        data = buffer.data();
+        size = buffer.length();
+        pos = 0;
+    }
+
+    // One line without its terminator; false when the line may continue past the data
+    bool takeLine(const char *&p, const char *end, const char *&line, size_t &length) const {
+        if (p == end) return false;
+        const char *newline = (const char *)memchr(p, '\n', end - p);
+        if (newline == nullptr && !atEof) return false;
+        line = p;
+        length = (newline != nullptr ? newline : end) - p;
+        p = newline != nullptr ? newline + 1 : end;
+        if (length > 0 && line[length - 1] == '\r') --length;
+        return true;
+    }
+
+    // 1 for a complete record, 0 when more input is needed, -1 at the end or on bad input
+    int parseRecord(const char *p, const char *end, SequenceRecord &record, size_t &consumed) {
+        const char *start = p, *line;
+        size_t length;
+
+        do {
+            if (!takeLine(p, end, line, length)) return p == end && atEof ? -1 : 0;
+        } while (length == 0);
+        if (line[0] != '>' && line[0] != '@') return -1;
+
+        bool fastq = line[0] == '@';
+        record.name = line + 1;
+        record.nameLength = length - 1;
+        record.quality = nullptr;
+        record.qualityLength = 0;
+
+        // Sequence lines run up to the next header (FASTA) or the '+' separator (FASTQ)
+        int lines = 0;
+        for (;;) {
+            if (p == end) {
+                if (!atEof) return 0;
+                if (fastq) return -1;
+                break;
+            }
+            if (*p == '>' && !fastq) break;
+            if (!takeLine(p, end, line, length)) return 0;
+            if (fastq && length > 0 && line[0] == '+') break;
+            if (length == 0) continue;
+            appendLine(lines++, line, length, record.sequence, record.length, joinedSequence);
+        }
+        if (lines == 0) {
+            record.sequence = p;
+            record.length = 0;
+        }
+
+        // Quality lines until they cover the sequence
+        if (fastq) {
+            lines = 0;
+            size_t covered = 0;
+            while (covered < record.length) {
+                if (!takeLine(p, end, line, length)) return atEof ? -1 : 0;
+                appendLine(lines++, line, length, record.quality, record.qualityLength, joinedQuality);
+                covered += length;
+            }
+        }
+
+        consumed = p - start;
+        return 1;
+    }
+
+    // First line as a view, later lines joined into the reusable buffer
+    static void appendLine(int index, const char *line, size_t length, const char *&view, size_t &viewLength, string &joined) {
+        if (index == 0) {
+            view = line;
+            viewLength = length;
+            return;
+        }
+        if (index == 1) joined.assign(view, viewLength);
+        joined.append(line, length);
+        view = joined.data();
+        viewLength = joined.length();
+    }
+};
+
+// Call visit for every record of a FASTA or FASTQ file
+bool forEachSequence(const string &fileName, const function<void(const SequenceRecord &)> &visit) {
+    SequenceReader reader;
+    if (!reader.open(fileName)) return false;
+
+    SequenceRecord record;
+    while (reader.next(record)) visit(record);
+    return true;
+}
+
+/*
+    Synthesis screening.
+
+    --screen checks sequences against the usual synthesis constraints in one streaming pass:
+    the GC fraction of every --gc-window window, homopolymer runs longer than --max-run, and
+    the forbidden motifs of --motifs on either strand. A .dna file is read in 4 MB chunks as
+    one sequence; FASTA and FASTQ files are screened record by record. Violations are listed
+    with their 0-based positions, up to screenReportLimit of each kind per file, and every
+    file ends with a summary: GC, the window GC range, and a histogram of run lengths.
+
+    Each chunk is first turned into two bitmaps, one bit per base, with AVX2: the G/C bases
+    and the bases that differ from the one before. The GC count of the window then only
+    changes where the bitmap of the bases entering the window differs from that of the bases
+    leaving it, so a 64-base block whose popcounts cannot reach a limit, or the lowest or
+    highest window yet, is skipped as a whole; any other block is stepped without branches,
+    and gone through base by base only when one of its windows breaks a limit. Runs are walked from one set bit of the change
+    bitmap to the next. Motifs go through an Aho-Corasick automaton over A, C, G and T with
+    every transition filled in, one table lookup per base; any other symbol restarts it.
+*/
+
+static const size_t screenReportLimit = 100;    // violations listed per kind and file
+static const size_t screenHistogram = 16;       // run lengths counted one by one, longer ones together
+
+// Lines "name = <nt>", or just "<nt>" named after itself; '#' starts a comment
+bool readMotifList(const string &fileName, vector<ScreenMotif> &motifs) {
+    string contents;
+    if (!openFile(fileName, contents, ios::in)) {
+        cerr << "Could not open motif list: " << fileName << endl;
+        return false;
+    }
+    istringstream lines(contents);
+    string line;
+    for (size_t number = 1; getline(lines, line); ++number) {
+        line = line.substr(0, line.find('#'));
+        size_t equals = line.find('=');
+        ScreenMotif motif;
+        motif.name = equals == string::npos ? "" : line.substr(0, equals);
+        motif.sequence = equals == string::npos ? line : line.substr(equals + 1);
+        motif.name.erase(remove_if(motif.name.begin(), motif.name.end(), ::isspace), motif.name.end());
+        motif.sequence.erase(remove_if(motif.sequence.begin(), motif.sequence.end(), ::isspace), motif.sequence.end());
+        transform(motif.sequence.begin(), motif.sequence.end(), motif.sequence.begin(), ::toupper);
+        if (motif.sequence.empty() && equals == string::npos) continue;
+        if (motif.sequence.empty() || motif.sequence.length() > 1024 ||
+            motif.sequence.find_first_not_of("ACGT") != string::npos) {
+            cerr << fileName << ":" << number << ": expecting [name =] <1-1024 nt of A, C, G and T>" << endl;
+            return false;
+        }
+        if (motif.name.empty()) motif.name = motif.sequence;
+        motifs.push_back(motif);
+    }
+    return true;
+}
+
+// Aho-Corasick automaton of the motifs and their reverse complements
+struct MotifMatcher {
+    struct Pattern {
+        size_t motif, length;
+        bool reverse;
+    };
+    vector<int32_t> next;               // 4 transitions per state
+    vector<int32_t> firstMatch;         // per state, first pattern ending there or at a suffix state, -1 if none
+    vector<int32_t> steps;              // 8 columns per state, ACGT then any other symbol, to 8 * state, negative
+                                        // when a pattern ends there
+    unsigned char columns[256];
+    vector<int32_t> nextMatch;          // per pattern, the next pattern ending at the same place, -1 at the end
+    vector<Pattern> patterns;
+
+    explicit MotifMatcher(const vector<ScreenMotif> &motifs) : next(4, -1), firstMatch(1, -1) {
+        const unsigned char *codes = nucleotideCodes();
+        vector<int32_t> ownMatches(1, -1);
+        for (size_t m = 0; m < motifs.size(); ++m) {
+            string reverse = reverseComplementOf(motifs[m].sequence);
+            for (int strand = 0; strand < 2; ++strand) {
+                // A palindromic site is reported once
+                if (strand == 1 && reverse == motifs[m].sequence) break;
+                const string &sequence = strand == 0 ? motifs[m].sequence : reverse;
+                int32_t state = 0;
+                for (char base : sequence) {
+                    size_t edge = state * 4 + codes[(unsigned char)base];
+                    if (next[edge] < 0) {
+                        next[edge] = (int32_t)ownMatches.size();
+                        ownMatches.push_back(-1);
+                        next.resize(next.size() + 4, -1);
+                    }
+                    state = next[edge];
+                }
+                Pattern pattern = {m, sequence.length(), strand == 1};
+                nextMatch.push_back(ownMatches[state]);
+                ownMatches[state] = (int32_t)patterns.size();
+                patterns.push_back(pattern);
+            }
+        }
+
+        // Breadth first, so the failure state of each state is complete before its children
+        vector<int32_t> failure(ownMatches.size(), 0), queue;
+        firstMatch.assign(ownMatches.size(), -1);
+        firstMatch[0] = ownMatches[0];
+        for (int c = 0; c < 4; ++c) {
+            if (next[c] < 0) {
+                next[c] = 0;
+            } else {
+                queue.push_back(next[c]);
+            }
+        }
+        for (size_t q = 0; q < queue.size(); ++q) {
+            int32_t state = queue[q];
+            // Patterns ending here come first, then those of the failure state
+            if (ownMatches[state] >= 0) {
+                int32_t last = ownMatches[state];
+                while (nextMatch[last] >= 0) last = nextMatch[last];
+                nextMatch[last] = firstMatch[failure[state]];
+                firstMatch[state] = ownMatches[state];
+            } else {
+                firstMatch[state] = firstMatch[failure[state]];
+            }
+            for (int c = 0; c < 4; ++c) {
+                int32_t &edge = next[state * 4 + c];
+                if (edge < 0) {
+                    edge = next[failure[state] * 4 + c];
+                } else {
+                    failure[edge] = next[failure[state] * 4 + c];
+                    queue.push_back(edge);
+                }
+            }
+        }
+
+        steps.assign(ownMatches.size() * 8, 0);
+        for (size_t state = 0; state < ownMatches.size(); ++state) {
+            for (int c = 0; c < 4; ++c) {
+                int32_t target = next[state * 4 + c];
+                steps[state * 8 + c] = firstMatch[target] >= 0 ? ~(target * 8) : target * 8;
+            }
+        }
+        for (int c = 0; c < 256; ++c) columns[c] = codes[c & ~0x20] > 3 ? 4 : codes[c & ~0x20];
+    }
+};
+
+#ifdef DNA_CODEC_X86
+// 32 bits per 32 bases: G/C, and differs from the previous base; base 0 is left to the caller
+__attribute__((target("avx2")))
+static size_t screenBitsAVX2(const char *text, size_t length, uint32_t *gc, uint32_t *change) {
+    const __m256i lower = _mm256_set1_epi8(0x20), c = _mm256_set1_epi8('c'), g = _mm256_set1_epi8('g');
+    size_t i = 32;
+    for (; i + 32 <= length; i += 32) {
+        __m256i bases = _mm256_loadu_si256((const __m256i *)(text + i));
+        __m256i previous = _mm256_loadu_si256((const __m256i *)(text + i - 1));
+        __m256i folded = _mm256_or_si256(bases, lower);
+        __m256i strong = _mm256_or_si256(_mm256_cmpeq_epi8(folded, c), _mm256_cmpeq_epi8(folded, g));
+        gc[i / 32] = (uint32_t)_mm256_movemask_epi8(strong);
+        change[i / 32] = ~(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(bases, previous));
+    }
+    return i;
+}
+#endif
+
+// Bitmaps of the G/C bases and of the bases that differ from the one before, bit i for base i
+static void screenBits(const char *text, size_t length, vector<uint64_t> &gc, vector<uint64_t> &change) {
+    gc.assign(length / 64 + 2, 0);
+    change.assign(length / 64 + 2, 0);
+    size_t i = 0;
+#ifdef DNA_CODEC_X86
+    // Whole 32-bit halves of little-endian words
+    if (length >= 64 && cpuHasAVX2()) i = screenBitsAVX2(text, length, (uint32_t *)gc.data(), (uint32_t *)change.data());
+#endif
+    for (size_t j = 0; j < 32 && j < length; ++j) {
+        unsigned char folded = (unsigned char)text[j] | 0x20;
+        gc[0] |= uint64_t(folded == 'c' || folded == 'g') << j;
+        change[0] |= uint64_t(j > 0 && text[j] != text[j - 1]) << j;
+    }
+    for (i = max<size_t>(i, 32); i < length; ++i) {
+        unsigned char folded = (unsigned char)text[i] | 0x20;
+        gc[i / 64] |= uint64_t(folded == 'c' || folded == 'g') << (i % 64);
+        change[i / 64] |= uint64_t(text[i] != text[i - 1]) << (i % 64);
+    }
+}
+
+// 64 bits of a bitmap from bit position on
+static inline uint64_t bitsAt(const vector<uint64_t> &bits, size_t position) {
+    size_t word = position / 64, shift = position % 64;
+    return shift == 0 ? bits[word] : bits[word] >> shift | bits[word + 1] << (64 - shift);
+}
+
+struct ScreenSummary {
+    size_t bases, gc;
+    size_t windows, lowestWindow, highestWindow;       // GC counts of the full windows
+    size_t longestRun, runs[screenHistogram + 1];
+    size_t gcViolations, runViolations, motifSites;
+    size_t reportLimit;                                 // violations listed per kind
+
+    ScreenSummary() : bases(0), gc(0), windows(0), lowestWindow(SIZE_MAX), highestWindow(0), longestRun(0), runs(),
+                      gcViolations(0), runViolations(0), motifSites(0), reportLimit(screenReportLimit) {}
+};
+
+// One sequence fed in chunks of any size
+class SequenceScreen {
+public:
+    SequenceScreen(const MotifMatcher &matcher, const vector<ScreenMotif> &motifs, const CodecOptions &options,
+                   ScreenSummary &summary, const string &label)
+        : matcher(matcher), motifs(motifs), summary(summary), label(label), window(options.gcWindow),
+          lowCount((options.gcMin * window + 99) / 100), highCount(options.gcMax * window / 100), maxRun(options.maxRun),
+          gcMin(options.gcMin), gcMax(options.gcMax),
+          start(0), count(0), runStart(0), state(0), outside(0), outsideStart(0), outsideExtreme(0) {}
+
+    void feed(const char *data, size_t length) {
+        // Keep the bases still inside the window, and the last base for the runs
+        size_t keep = min(text.length(), window);
+        start += text.length() - keep;
+        text.erase(0, text.length() - keep);
+        size_t first = text.length();
+        text.append(data, length);
+        screenBits(text.data(), text.length(), gcBits, changeBits);
+
+        for (size_t i = first; i < text.length(); i += 64) {
+            size_t block = min<size_t>(64, text.length() - i);
+            uint64_t valid = block == 64 ? ~0ULL : (uint64_t(1) << block) - 1;
+            screenWindows(i, block, valid);
+            screenRuns(i, valid);
+            screenMotifs(i, i + block);
+        }
+        summary.bases += length;
+    }
+
+    void finish() {
+        if (text.empty()) return;
+        size_t end = start + text.length();
+        closeRun(end, text.back());
+        closeWindows(end);
+    }
+
+private:
+    const MotifMatcher &matcher;
+    const vector<ScreenMotif> &motifs;
+    ScreenSummary &summary;
+    string label;
+    size_t window, lowCount, highCount, maxRun;
+    int gcMin, gcMax;
+    string text;                        // bases from position start on
+    vector<uint64_t> gcBits, changeBits;
+    size_t start, count, runStart;
+    int32_t state;                      // automaton state times 8
+    int outside;                        // -1 or 1 while windows are below or above the limits
+    size_t outsideStart, outsideExtreme;
+
+    static double percent(size_t part, size_t whole) {
+        return 100.0 * part / whole;
+    }
+
+    // Counts a violation, and starts its line if it is still listed
+    bool listed(size_t &counter) {
+        if (counter++ >= summary.reportLimit) return false;
+        cout << "  " << label;
+        return true;
+    }
+
+    // Window GC counts, the window ending at base i from window - 1 on
+    void screenWindows(size_t i, size_t block, uint64_t valid) {
+        uint64_t entering = bitsAt(gcBits, i) & valid;
+        size_t position = start + i;
+        summary.gc += __builtin_popcountll(entering);
+        if (position >= window && outside == 0) {
+            uint64_t leaving = bitsAt(gcBits, i - window) & valid;
+            size_t gained = __builtin_popcountll(entering & ~leaving), lost = __builtin_popcountll(leaving & ~entering);
+            // Bounds on every window of the block; lost can exceed count when the window is shorter than the block
+            if (count >= lost + max(lowCount, summary.lowestWindow) && count + gained <= min(highCount, summary.highestWindow)) {
+                count += gained - lost;
+                summary.windows += block;
+                return;
+            }
+            // Otherwise step without branches, and only go back base by base if a window is outside the limits
+            size_t stepped = count, lowest = count, highest = count;
+            for (size_t j = 0; j < block; ++j) {
+                stepped += ((entering >> j) & 1) - ((leaving >> j) & 1);
+                lowest = min(lowest, stepped);
+                highest = max(highest, stepped);
+            }
+            if (lowest >= lowCount && highest <= highCount) {
+                count = stepped;
+                summary.windows += block;
+                summary.lowestWindow = min(summary.lowestWindow, lowest);
+                summary.highestWindow = max(summary.highestWindow, highest);
+                return;
+            }
+        }
+        for (size_t j = 0; j < block; ++j, ++position) {
+            count += (entering >> j) & 1;
+            if (position >= window) count -= (gcBits[(i + j - window) / 64] >> ((i + j - window) % 64)) & 1;
+            if (position + 1 >= window) checkWindow(position + 1 - window);
+        }
+    }
+
+    void checkWindow(size_t windowStart) {
+        ++summary.windows;
+        summary.lowestWindow = min(summary.lowestWindow, count);
+        summary.highestWindow = max(summary.highestWindow, count);
+        int side = count < lowCount ? -1 : count > highCount ? 1 : 0;
+        if (side != outside) {
+            closeWindows(windowStart - 1 + window);
+            outside = side;
+            outsideStart = windowStart;
+            outsideExtreme = count;
+        } else if (side != 0) {
+            outsideExtreme = side < 0 ? min(outsideExtreme, count) : max(outsideExtreme, count);
+        }
+    }
+
+    // Ends a stretch of windows outside the limits, covering bases up to end
+    void closeWindows(size_t end) {
+        if (outside == 0) return;
+        if (listed(summary.gcViolations)) {
+            cout << "GC " << fixed << setprecision(1) << percent(outsideExtreme, window) << defaultfloat << setprecision(6) << "% "
+                 << (outside < 0 ? "below " : "above ") << (outside < 0 ? gcMin : gcMax) << "% in " << outsideStart << "-" << end - 1 << endl;
+        }
+        outside = 0;
+    }
+
+    void screenRuns(size_t i, uint64_t valid) {
+        uint64_t boundaries = bitsAt(changeBits, i) & valid;
+        if (start + i == 0) boundaries &= ~1ULL;
+        while (boundaries != 0) {
+            size_t j = i + __builtin_ctzll(boundaries);
+            closeRun(start + j, text[j - 1]);
+            runStart = start + j;
+            boundaries &= boundaries - 1;
+        }
+    }
+
+    void closeRun(size_t end, char base) {
+        size_t length = end - runStart;
+        ++summary.runs[min(length, screenHistogram)];
+        summary.longestRun = max(summary.longestRun, length);
+        if (length > maxRun && listed(summary.runViolations)) cout << "run of " << length << " " << base << " at " << runStart << endl;
+    }
+
+    void screenMotifs(size_t first, size_t end) {
+        const int32_t *steps = matcher.steps.data();
+        const unsigned char *columns = matcher.columns;
+        for (size_t i = first; i < end; ++i) {
+            state = steps[state + columns[(unsigned char)text[i]]];
+            if (state >= 0) continue;
+            state = ~state;
+            for (int32_t p = matcher.firstMatch[state / 8]; p >= 0; p = matcher.nextMatch[p]) {
+                const MotifMatcher::Pattern &pattern = matcher.patterns[p];
+                const ScreenMotif &motif = motifs[pattern.motif];
+                if (listed(summary.motifSites)) {
+                    cout << motif.name << " " << motif.sequence << " at " << start + i + 1 - pattern.length
+                         << (pattern.reverse ? " (reverse strand)" : "") << endl;
+                }
+            }
+        }
+    }
+};
+
+static void printScreenSummary(const string &fileName, const ScreenSummary &summary, const CodecOptions &options) {
+    cout.precision(2);
+    cout << fixed << fileName << ": " << summary.bases << " nt, GC "
+         << (summary.bases > 0 ? 100.0 * summary.gc / summary.bases : 0) << "%";
+    if (summary.windows > 0) {
+        cout << ", " << options.gcWindow << "-nt window GC " << 100.0 * summary.lowestWindow / options.gcWindow << "-"
+             << 100.0 * summary.highestWindow / options.gcWindow << "%";
+    }
+    cout << ", longest run " << summary.longestRun << endl << "  run lengths:";
+    for (size_t length = 1; length <= screenHistogram; ++length) {
+        if (summary.runs[length] > 0) cout << " " << length << (length == screenHistogram ? "+" : "") << ":" << summary.runs[length];
+    }
+    cout << endl << "  " << summary.gcViolations << " GC stretch(es) outside " << options.gcMin << "-" << options.gcMax << "%, "
+         << summary.runViolations << " run(s) over " << options.maxRun << " nt, " << summary.motifSites << " motif site(s)" << endl;
+    cout.unsetf(ios::fixed);
+    cout.precision(6);
+}
+
+bool doScreen(const vector<string>& fileNames) {
+    MotifMatcher matcher(screenMotifs);
+    bool clean = true;
+    for (const string &fileName : fileNames) {
+        ScreenSummary summary;
+        bool dna = fileName.size() > 4 && fileName.compare(fileName.size() - 4, 4, ".dna") == 0;
+        if (dna) {
+            // One sequence, streamed
+            int fd = open(fileName.c_str(), O_RDONLY);
+            if (fd < 0) {
+                cerr << "Could not open file: " << fileName << endl;
+                return false;
+            }
+            SequenceScreen screen(matcher, screenMotifs, codecOptions, summary, "");
+            string chunk(4 << 20, '\0');
+            ssize_t n;
+            while ((n = read(fd, &chunk[0], chunk.length())) > 0) {
+                // A trailing line end is not part of the sequence
+                while (n > 0 && (chunk[n - 1] == '\n' || chunk[n - 1] == '\r')) --n;
+                screen.feed(chunk.data(), n);
+            }
+            close(fd);
+            screen.finish();
+        } else if (!forEachSequence(fileName, [&](const SequenceRecord &read) {
+                       SequenceScreen screen(matcher, screenMotifs, codecOptions, summary,
+                                             string(read.name, read.nameLength) + ": ");
+                       screen.feed(read.sequence, read.length);
+                       screen.finish();
+                   })) {
+            cerr << "Could not open file: " << fileName << endl;
+            return false;
+        }
+        printScreenSummary(fileName, summary, codecOptions);
+        clean = clean && summary.gcViolations == 0 && summary.runViolations == 0 && summary.motifSites == 0;
+    }
+    // Any violation fails the screen, so it can gate a synthesis order
+    return clean;
+}
+
+/*
+    Codon analysis.
+
+    --codons reads the payload in codons, from the base after the PROMOTER to the TERMINATOR
+    (and MARKER), and counts the use of each of the 64 codons. It lists the in-frame stop
+    codons TAA, TAG and TGA and the codons of --rare-codons with their positions, up to
+    codonReportLimit of each per file. The default rare codons are those E. coli strains are
+    short of tRNA for, and that Rosetta strains supply. A .dna file is streamed in 4 MB chunks;
+    FASTA and FASTQ files are read record by record, each oligo in its own frame.
+
+    A codon is indexed 16 * first + 4 * second + third base code, with A, C, G, T as 0-3, and
+    index 64 stands for a codon holding another symbol. SSSE3 gathers the first, second and
+    third bases of 16 codons from 48 bytes with three PSHUFBs each, and looks indices up in
+    64-entry tables as four 16-entry PSHUFBs selected by the top two bits. That one lookup
+    kernel translates to amino acids (--translate 1, into <file>.faa) and, until the listings
+    are full, finds the stop and rare codons. Usage is counted in four interleaved histograms.
+*/
+
+static const size_t codonReportLimit = 100;     // stop and rare codons listed per file
+static const size_t invalidCodon = 64;
+static const char geneticCode[] = "KNKNTTTTRSRSIIMIQHQHPPPPRRRRLLLLEDEDAAAAGGGGVVVV*Y*YSSSS*CWCLFLFX";
+
+static string codonName(size_t index) {
+    if (index >= invalidCodon) return "NNN";
+    return string(1, nucleotideSymbols[index >> 4]) + nucleotideSymbols[(index >> 2) & 3] + nucleotideSymbols[index & 3];
+}
+
+// Comma separated codons of A, C, G and T
+bool parseCodonList(const char *list, uint64_t &codons) {
+    const unsigned char *codes = nucleotideCodes();
+    codons = 0;
+    for (const char *p = list; *p != '\0'; p += p[3] == ',' ? 4 : 3) {
+        unsigned char first = codes[toupper((unsigned char)p[0])], second = first > 3 ? 0xFF : codes[toupper((unsigned char)p[1])];
+        unsigned char third = second > 3 ? 0xFF : codes[toupper((unsigned char)p[2])];
+        if (third > 3 || (p[3] != ',' && p[3] != '\0') || (p[3] == ',' && p[4] == '\0')) {
+            cerr << "Expecting comma separated codons of A, C, G and T: " << list << endl;
+            return false;
+        }
+        codons |= uint64_t(1) << (16 * first + 4 * second + third);
+    }
+    return true;
+}
+
+#ifdef DNA_CODEC_X86
+struct CodonShuffles {
+    unsigned char gather[3][3][16];     // base of each codon, from each of three 16-byte registers
+    CodonShuffles() {
+        for (int base = 0; base < 3; ++base) {
+            for (int part = 0; part < 3; ++part) {
+                for (int lane = 0; lane < 16; ++lane) {
+                    int position = 3 * lane + base - 16 * part;
+                    gather[base][part][lane] = position >= 0 && position < 16 ? (unsigned char)position : 0x80;
+                }
+            }
+        }
+    }
+};
+
+__attribute__((target("ssse3")))
+static size_t codonIndicesSSSE3(const char *bases, size_t codons, unsigned char *indices) {
+    static const CodonShuffles shuffles;
+    // Bits 1-2 of A, C, G, T are 0, 1, 3, 2, case folded
+    const __m128i toCodes = _mm_setr_epi8(0, 1, 3, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i symbols = _mm_setr_epi8('A', 'C', 'G', 'T', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i three = _mm_set1_epi8(3), upper = _mm_set1_epi8((char)~0x20);
+    size_t i = 0;
+    for (; i + 16 <= codons; i += 16) {
+        __m128i codes[3], valid = _mm_set1_epi8(-1);
+        for (int part = 0; part < 3; ++part) {
+            __m128i text = _mm_and_si128(_mm_loadu_si128((const __m128i *)(bases + 3 * i + 16 * part)), upper);
+            codes[part] = _mm_shuffle_epi8(toCodes, _mm_and_si128(_mm_srli_epi16(text, 1), three));
+            valid = _mm_and_si128(valid, _mm_cmpeq_epi8(text, _mm_shuffle_epi8(symbols, codes[part])));
+        }
+        // Codons with another symbol go to the scalar loop
+        if (_mm_movemask_epi8(valid) != 0xFFFF) break;
+        __m128i index = _mm_setzero_si128();
+        for (int base = 0; base < 3; ++base) {
+            __m128i gathered = _mm_setzero_si128();
+            for (int part = 0; part < 3; ++part) {
+                gathered = _mm_or_si128(gathered, _mm_shuffle_epi8(codes[part], _mm_loadu_si128((const __m128i *)shuffles.gather[base][part])));
+            }
+            index = _mm_or_si128(_mm_slli_epi16(index, 2), gathered);
+        }
+        _mm_storeu_si128((__m128i *)(indices + i), index);
+    }
+    return i;
+}
+
+__attribute__((target("ssse3")))
+static size_t lookupCodonsSSSE3(const unsigned char *indices, size_t codons, const unsigned char table[65], unsigned char *out) {
+    __m128i quarters[4];
+    for (int q = 0; q < 4; ++q) quarters[q] = _mm_loadu_si128((const __m128i *)(table + 16 * q));
+    const __m128i invalid = _mm_set1_epi8((char)table[invalidCodon]), low = _mm_set1_epi8(15);
+    size_t i = 0;
+    for (; i + 16 <= codons; i += 16) {
+        __m128i index = _mm_loadu_si128((const __m128i *)(indices + i));
+        __m128i quarter = _mm_srli_epi16(_mm_andnot_si128(low, index), 4), nibble = _mm_and_si128(index, low);
+        __m128i result = _mm_and_si128(_mm_cmpeq_epi8(quarter, _mm_set1_epi8(4)), invalid);
+        for (int q = 0; q < 4; ++q) {
+            __m128i selected = _mm_cmpeq_epi8(quarter, _mm_set1_epi8((char)q));
+            result = _mm_or_si128(result, _mm_and_si128(selected, _mm_shuffle_epi8(quarters[q], nibble)));
+        }
+        _mm_storeu_si128((__m128i *)(out + i), result);
+    }
+    return i;
+}
+#endif
+
+// Index of each codon, invalidCodon for one holding a symbol other than ACGT
+void codonIndices(const char *bases, size_t codons, unsigned char *indices) {
+    const unsigned char *codes = nucleotideCodes();
+    size_t i = 0;
+    for (;;) {
+#ifdef DNA_CODEC_X86
+        if (cpuHasSSSE3()) i += codonIndicesSSSE3(bases + 3 * i, codons - i, indices + i);
+#endif
+        if (i == codons) return;
+        // One codon at a time up to the next whole block, then back to the vector loop
+        for (size_t end = min(codons, i + 16); i < end; ++i) {
+            unsigned first = codes[toupper((unsigned char)bases[3 * i])], second = codes[toupper((unsigned char)bases[3 * i + 1])];
+            unsigned third = codes[toupper((unsigned char)bases[3 * i + 2])];
+            indices[i] = (first | second | third) > 3 ? invalidCodon : (unsigned char)(16 * first + 4 * second + third);
+        }
+    }
+}
+
+// table[index] of each codon index
+static void lookupCodons(const unsigned char *indices, size_t codons, const unsigned char table[65], unsigned char *out) {
+    size_t i = 0;
+#ifdef DNA_CODEC_X86
+    if (cpuHasSSSE3()) i = lookupCodonsSSSE3(indices, codons, table, out);
+#endif
+    for (; i < codons; ++i) out[i] = table[indices[i]];
+}
+
+struct CodonSummary {
+    size_t codons, counts[invalidCodon + 1];
+    size_t stopsListed, rareListed, trailing;
+
+    CodonSummary() : codons(0), counts(), stopsListed(0), rareListed(0), trailing(0) {}
+};
+
+// One sequence fed in chunks of any size; the flanks are dropped from its ends
+class CodonAnalysis {
+public:
+    CodonAnalysis(const CodecOptions &options, CodonSummary &summary, const string &label, const string &trailer,
+                  ostream *protein)
+        : summary(summary), label(label), trailer(trailer), protein(protein), started(false), codon(0), offset(0) {
+        for (size_t index = 0; index <= invalidCodon; ++index) {
+            flags[index] = (geneticCode[index] == '*' ? 1 : 0) | (index < invalidCodon && (options.rareCodons >> index & 1) ? 2 : 0);
+        }
+    }
+
+    void feed(const char *data, size_t length) {
+        pending.append(data, length);
+        if (!started) {
+            // Wait for enough bases to tell whether the sequence starts with the PROMOTER
+            if (pending.length() < flankSet.promoter.length() && length > 0) return;
+            if (pending.compare(0, flankSet.promoter.length(), flankSet.promoter) == 0) {
+                pending.erase(0, flankSet.promoter.length());
+                offset = flankSet.promoter.length();
+            }
+            started = true;
+        }
+        // The trailer is held back until the end
+        size_t ready = pending.length() > trailer.length() ? (pending.length() - trailer.length()) / 3 : 0;
+        analyse(ready);
+    }
+
+    void finish() {
+        feed(nullptr, 0);
+        if (pending.length() >= trailer.length() && pending.compare(pending.length() - trailer.length(), trailer.length(), trailer) == 0) {
+            pending.resize(pending.length() - trailer.length());
+        }
+        analyse(pending.length() / 3);
+        summary.trailing += pending.length();
+    }
+
+private:
+    CodonSummary &summary;
+    string label, trailer;
+    ostream *protein;
+    unsigned char flags[invalidCodon + 1];      // 1 for a stop codon, 2 for a rare one
+    string pending;
+    bool started;
+    size_t codon, offset;                       // first codon of pending, and its offset in nucleotides
+    vector<unsigned char> indices, looked;
+
+    void analyse(size_t codons) {
+        if (codons == 0) return;
+        indices.resize(codons);
+        looked.resize(codons);
+        codonIndices(pending.data(), codons, indices.data());
+
+        size_t counts[4][invalidCodon + 1] = {};
+        size_t i = 0;
+        for (; i + 4 <= codons; i += 4) {
+            ++counts[0][indices[i]];
+            ++counts[1][indices[i + 1]];
+            ++counts[2][indices[i + 2]];
+            ++counts[3][indices[i + 3]];
+        }
+        for (; i < codons; ++i) ++counts[0][indices[i]];
+        for (size_t index = 0; index <= invalidCodon; ++index) {
+            summary.counts[index] += counts[0][index] + counts[1][index] + counts[2][index] + counts[3][index];
+        }
+
+        if (summary.stopsListed < codonReportLimit || summary.rareListed < codonReportLimit) {
+            lookupCodons(indices.data(), codons, flags, looked.data());
+            for (i = 0; i < codons; ++i) {
+                if (looked[i] == 0) continue;
+                size_t &listed = looked[i] & 1 ? summary.stopsListed : summary.rareListed;
+                if (listed >= codonReportLimit) continue;
+                ++listed;
+                cout << "  " << label << (looked[i] & 1 ? "stop " : "rare ") << codonName(indices[i]) << " at codon "
+                     << codon + i << ", nt " << offset + 3 * (codon + i) << endl;
+            }
+        }
+        if (protein != nullptr) {
+            lookupCodons(indices.data(), codons, (const unsigned char *)geneticCode, looked.data());
+            protein->write((const char *)looked.data(), codons);
+        }
+
+        summary.codons += codons;
+        codon += codons;
+        pending.erase(0, 3 * codons);
+    }
+};
+
+static void printCodonSummary(const string &fileName, const CodonSummary &summary, const CodecOptions &options) {
+    const size_t *counts = summary.counts;
+    size_t stops = counts[48] + counts[50] + counts[56], rare = 0;
+    for (size_t index = 0; index < invalidCodon; ++index) rare += (options.rareCodons >> index & 1) ? counts[index] : 0;
+    cout << fileName << ": " << summary.codons << " codons, " << stops << " stop (TAA " << counts[48] << ", TAG "
+         << counts[50] << ", TGA " << counts[56] << "), " << rare << " rare, " << counts[invalidCodon] << " with other symbols";
+    if (summary.trailing > 0) cout << ", " << summary.trailing << " nt out of frame";
+    cout << endl << "  usage per thousand:" << fixed << setprecision(1);
+    for (size_t index = 0; index < invalidCodon; ++index) {
+        cout << (index % 8 == 0 ? "\n   " : "") << " " << codonName(index) << " " << geneticCode[index] << " " << setw(5)
+             << (summary.codons > 0 ? 1000.0 * counts[index] / summary.codons : 0);
+    }
+    cout << defaultfloat << setprecision(6) << endl;
+}
+
+bool doCodons(const vector<string>& fileNames) {
+    for (const string &fileName : fileNames) {
+        CodonSummary summary;
+        ofstream protein;
+        if (codecOptions.translate) {
+            protein.open(fileName + ".faa", ios::binary | ios::trunc);
+            if (!protein.is_open()) {
+                cerr << "Could not create file: " << fileName << ".faa" << endl;
+                return false;
+            }
+        }
+        ostream *out = codecOptions.translate ? &protein : nullptr;
+        bool dna = fileName.size() > 4 && fileName.compare(fileName.size() - 4, 4, ".dna") == 0;
+        if (dna) {
+            int fd = open(fileName.c_str(), O_RDONLY);
+            if (fd < 0) {
+                cerr << "Could not open file: " << fileName << endl;
+                return false;
+            }
+            if (out != nullptr) *out << ">" << fileName << "\n";
+            CodonAnalysis analysis(codecOptions, summary, "", flankSet.terminator + flankSet.marker, out);
+            string chunk(4 << 20, '\0');
+            ssize_t n;
+            while ((n = read(fd, &chunk[0], chunk.length())) > 0) {
+                // A trailing line end is not part of the sequence
+                while (n > 0 && (chunk[n - 1] == '\n' || chunk[n - 1] == '\r')) --n;
+                analysis.feed(chunk.data(), n);
+            }
+            close(fd);
+            analysis.finish();
+            if (out != nullptr) *out << "\n";
+        } else if (!forEachSequence(fileName, [&](const SequenceRecord &read) {
+                       string name(read.name, read.nameLength);
+                       if (out != nullptr) *out << ">" << name << "\n";
+                       CodonAnalysis analysis(codecOptions, summary, name + ": ", flankSet.terminator, out);
+                       analysis.feed(read.sequence, read.length);
+                       analysis.finish();
+                       if (out != nullptr) *out << "\n";
+                   })) {
+            cerr << "Could not open file: " << fileName << endl;
+            return false;
+        }
+        printCodonSummary(fileName, summary, codecOptions);
+    }
+    return true;
+}
+
+/*
+    Encoded search.
+
+    A plain payload maps each byte to one 4-nucleotide word, aligned to the start of its
+    record, so --grep translates a byte pattern to nucleotides and searches the .dna file as
+    it is. A match is a match of the translation at a multiple of 4 nucleotides from the
+    start of the record's contents. Files are mapped and never decoded: only the header of
+    each record is read, to find where its contents start and how long they are. AVX2
+    compares the first and the last word of the pattern with 8 aligned words of text at a
+    time, and the few candidates are checked in full. Files are searched in parallel and
+    reported in command line order.
+
+    Archive members are searched one by one. Records whose body is not the contents as
+    written (whitened or Reed-Solomon coded), and payloads that are escaped, coded or on the
+    reverse strand, are reported as needing a decode instead.
+*/
+
+static const size_t grepHeaderBytes = 4096;     // record bytes read to find the start of the contents
+
+// Literal bytes of a pattern: \n, \t, \r, \0 and \xHH escapes, regex metacharacters only when escaped
+static bool parseGrepPattern(const string &text, string &bytes) {
+    bytes.clear();
+    for (size_t i = 0; i < text.length(); ++i) {
+        char c = text[i];
+        if (c != '\\') {
+            if (strchr(".^$*+?()[]{}|", c) != nullptr) return false;
+            bytes += c;
+            continue;
+        }
+        if (++i == text.length()) return false;
+        c = text[i];
+        if (c == 'x') {
+            if (i + 2 >= text.length() || !isxdigit((unsigned char)text[i + 1]) || !isxdigit((unsigned char)text[i + 2])) {
+                return false;
+            }
+            bytes += (char)stoi(text.substr(i + 1, 2), nullptr, 16);
+            i += 2;
+        } else if (c == 'n' || c == 't' || c == 'r' || c == '0') {
+            bytes += c == 'n' ? '\n' : c == 't' ? '\t' : c == 'r' ? '\r' : '\0';
+        } else if (isalnum((unsigned char)c)) {
+            return false;       // \d, \w and the like are classes, not literals
+        } else {
+            bytes += c;
+        }
+    }
+    return !bytes.empty();
+}
+
+#ifdef DNA_CODEC_X86
+// Candidates where the first and last words match, 8 aligned words at a time; returns the first offset not done
+__attribute__((target("avx2")))
+static size_t findAlignedAVX2(const char *text, size_t length, const string &pattern, vector<size_t> &hits) {
+    const size_t n = pattern.length();
+    uint32_t firstWord, lastWord;
+    memcpy(&firstWord, pattern.data(), 4);
+    memcpy(&lastWord, pattern.data() + n - 4, 4);
+    const __m256i first = _mm256_set1_epi32((int)firstWord), last = _mm256_set1_epi32((int)lastWord);
+    size_t i = 0;
+    for (; i + n - 4 + 32 <= length; i += 32) {
+        __m256i match = _mm256_and_si256(_mm256_cmpeq_epi32(first, _mm256_loadu_si256((const __m256i *)(text + i))),
+                                         _mm256_cmpeq_epi32(last, _mm256_loadu_si256((const __m256i *)(text + i + n - 4))));
+        for (unsigned mask = (unsigned)_mm256_movemask_ps(_mm256_castsi256_ps(match)); mask != 0; mask &= mask - 1) {
+            size_t at = i + 4 * __builtin_ctz(mask);
+            if (memcmp(text + at + 4, pattern.data() + 4, n - 4) == 0) hits.push_back(at);
+        }
+    }
+    return i;
+}
+#endif
+
+// Offsets of a whole-word pattern at multiples of 4 in text
+static void findAligned(const char *text, size_t length, const string &pattern, vector<size_t> &hits) {
+    size_t i = 0;
+#ifdef DNA_CODEC_X86
+    if (cpuHasAVX2()) i = findAlignedAVX2(text, length, pattern, hits);
+#endif
+    for (; i + pattern.length() <= length; i += 4) {
+        if (memcmp(text + i, pattern.data(), pattern.length()) == 0) hits.push_back(i);
+    }
+}
+
+// A whole file, mapped if it can be and read otherwise
+struct MappedFile {
+    const char *data;
+    size_t size;
+    bool mapped;
+    string contents;
+
+    MappedFile() : data(nullptr), size(0), mapped(false) {}
+
+    ~MappedFile() { close(); }
+
+    void close() {
+        if (mapped) munmap((void *)data, size);
+        data = nullptr;
+        size = 0;
+        mapped = false;
+        string().swap(contents);
+    }
+
+    // Drops whatever was open before, so a MappedFile can be opened again
+    bool open(const string &fileName) {
+        close();
+        int fd = ::open(fileName.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat info;
+        if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+            void *mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapping != MAP_FAILED) {
+                madvise(mapping, info.st_size, MADV_SEQUENTIAL);
+                data = (const char *)mapping;
+                size = info.st_size;
+                mapped = true;
+            }
+        }
+        ::close(fd);
+        if (mapped) return true;
+        if (!openFile(fileName, contents, ios::binary)) return false;
+        data = contents.data();
+        size = contents.length();
+        return true;
+    }
+};
+
+// Byte offset and length of the contents of a plain FILE or XFILE record, read from its header alone
+static bool recordContents(const char *dnaSeq, size_t length, string &name, size_t &offset, size_t &contentLength) {
+    string header;
+    if (!nucleotideToBytes(dnaSeq, min(length, 4 * grepHeaderBytes) / 4 * 4, header)) return false;
+    bool extended = header.rfind("XFILE:", 0) == 0;
+    if (!extended && header.rfind("FILE:", 0) != 0) return false;
+
+    size_t nameStart = extended ? 6 : 5;
+    size_t nameEnd = header.find(':', nameStart);
+    size_t sizeEnd = nameEnd == string::npos ? string::npos : header.find(':', nameEnd + 1);
+    uint64_t size;
+    if (sizeEnd == string::npos || !parseDecimal(header.substr(nameEnd + 1, sizeEnd - nameEnd - 1), size)) return false;
+    name = header.substr(nameStart, nameEnd - nameStart);
+    contentLength = size;
+    offset = sizeEnd + 1;
+    if (extended) {
+        // Only the flank set may be recorded: other options change the bytes of the body
+        size_t optionsEnd = header.find(':', offset);
+        CodecOptions options;
+        if (optionsEnd == string::npos || !parseRecordOptions(header.substr(offset, optionsEnd - offset), options) ||
+            options.rsParity > 0 || options.whitenSeed > 0) {
+            return false;
+        }
+        offset = optionsEnd + 1;
+    }
+    return contentLength <= length / 4 - offset;
+}
+
+// Lists the matches in one .dna file or archive; false, with the reason in errors, if it could not be searched
+static bool grepFile(const string &fileName, const string &pattern, string &report, string &errors) {
+    MappedFile file;
+    if (!file.open(fileName)) {
+        errors += "Could not open file: " + fileName + "\n";
+        return false;
+    }
+
+    // Each record's payload as a nucleotide range, named in the archive index if there is one
+    vector<ArchiveEntry> records;
+    ifstream archive(fileName, ios::binary);
+    uint64_t indexOffset;
+    if (!archive.is_open() || !readArchiveIndex(archive, records, indexOffset)) {
+        size_t start, payloadLength;
+        if (reverseStrand(file.data, file.size, flankSet.record)) {
+            errors += fileName + ": reverse strand, decode it with -o to search\n";
+            return false;
+        }
+        if (!locateFlanks(file.data, file.size, start, payloadLength)) {
+            errors += fileName + ": invalid DNA content header or content\n";
+            return false;
+        }
+        records.assign(1, ArchiveEntry{"", start, payloadLength});
+    }
+
+    size_t searched = 0, matches = 0;
+    vector<size_t> hits;
+    for (const ArchiveEntry &record : records) {
+        string name;
+        size_t offset, contentLength;
+        if (record.offset > file.size || record.length > file.size - record.offset ||
+            !recordContents(file.data + record.offset, record.length, name, offset, contentLength)) {
+            errors += fileName + ": " + (record.name.empty() ? "the payload" : record.name) +
+                      " is invalid, escaped, coded, whitened or Reed-Solomon coded, decode it to search\n";
+            continue;
+        }
+        ++searched;
+        hits.clear();
+        findAligned(file.data + record.offset + 4 * offset, 4 * contentLength, pattern, hits);
+        for (size_t hit : hits) report += fileName + ": " + name + " at " + to_string(hit / 4) + "\n";
+        matches += hits.size();
+    }
+    if (searched > 0) report += fileName + ": " + to_string(matches) + " match(es) in " + to_string(searched) + " record(s)\n";
+    return searched == records.size();
+}
+
+bool doGrep(const string& pattern, const vector<string>& fileNames) {
+    string bytes;
+    if (!parseGrepPattern(pattern, bytes)) {
+        cerr << "Invalid pattern: only literal bytes are searched, escape regex metacharacters with a backslash." << endl;
+        return false;
+    }
+    const string dnaPattern = bytesToNucleotide(bytes);
+
+    vector<string> reports(fileNames.size()), errors(fileNames.size());
+    vector<char> searched(fileNames.size());
+    parallelFor(fileNames.size(), [&](size_t begin, size_t end) {
+        for (size_t f = begin; f < end; ++f) searched[f] = grepFile(fileNames[f], dnaPattern, reports[f], errors[f]);
+    });
+    bool all = true;
+    for (size_t f = 0; f < fileNames.size(); ++f) {
+        cout << reports[f];
+        cerr << errors[f];
+        all = all && searched[f];
+    }
+    return all;
+}
+
+/*
+    FM-index.
+
+    --fm-index builds an FM-index of the whole nucleotide sequence of a .dna file and stores
+    it beside it as <file>.fmi, so --fm-find can count and locate any nucleotide motif, at any
+    offset and on either strand, in time that grows with the motif and the number of sites
+    rather than with the file. The suffix array comes from SA-IS, which is linear but
+    sequential; deriving the BWT, its rank blocks and the suffix array samples from it is
+    split across the threads.
+
+    The BWT is packed 2 bits a base into blocks of 128 rows, each holding the count of every
+    base before it, so a rank is one block read and a few popcounts. The '$' row is stored
+    as an A and discounted. Every 32nd row keeps its suffix array entry and locate walks the
+    LF mapping back to one. The sidecar records the size of the file it indexes, and a
+    stale one is refused.
+*/
+
+static const char fmMagic[8] = {'D', 'N', 'A', 'F', 'M', 'I', '1', '\0'};
+static const size_t fmBlockRows = 128;      // BWT rows of a rank block
+static const size_t fmSampleRows = 32;      // rows between suffix array samples
+static const size_t fmLocateLimit = 100;    // sites listed per strand
+
+struct FmHeader {
+    char magic[8];
+    uint64_t length;        // bases indexed
+    uint64_t sourceSize;    // size of the indexed file, to spot a stale sidecar
+    uint64_t primary;       // row of the '$'
+    uint64_t counts[5];     // rows before the suffixes starting with $, A, C, G, T
+};
+
+struct FmBlock {
+    uint32_t counts[4];     // bases of each kind in the rows before the block, the '$' as an A
+    uint64_t bases[4];      // 128 rows, 2 bits each, first row lowest
+};
+
+// SA-IS of s[0, n), where s[n - 1] is the only 0 and every symbol is below k
+template <typename T>
+static void suffixArrayIS(const T *s, uint32_t *sa, size_t n, size_t k) {
+    const uint32_t empty = UINT32_MAX;
+    vector<bool> stype(n);
+    stype[n - 1] = true;
+    for (size_t i = n - 1; i-- > 0;) stype[i] = s[i] < s[i + 1] || (s[i] == s[i + 1] && stype[i + 1]);
+    auto isLMS = [&](size_t i) { return i > 0 && stype[i] && !stype[i - 1]; };
+
+    vector<uint32_t> counts(k, 0), bucket(k);
+    for (size_t i = 0; i < n; ++i) ++counts[s[i]];
+    auto bucketStarts = [&]() {
+        uint32_t sum = 0;
+        for (size_t c = 0; c < k; ++c) bucket[c] = sum, sum += counts[c];
+    };
+    auto bucketEnds = [&]() {
+        uint32_t sum = 0;
+        for (size_t c = 0; c < k; ++c) bucket[c] = sum += counts[c];
+    };
+    // L-type suffixes from the left, S-type from the right, from the LMS suffixes in place
+    auto induce = [&]() {
+        bucketStarts();
+        for (size_t i = 0; i < n; ++i) {
+            uint32_t j = sa[i];
+            if (j != empty && j > 0 && !stype[j - 1]) sa[bucket[s[j - 1]]++] = j - 1;
+        }
+        bucketEnds();
+        for (size_t i = n; i-- > 0;) {
+            uint32_t j = sa[i];
+            if (j != empty && j > 0 && stype[j - 1]) sa[--bucket[s[j - 1]]] = j - 1;
+        }
+    };
+
+    // Sort the LMS substrings
+    fill(sa, sa + n, empty);
+    bucketEnds();
+    for (size_t i = n; i-- > 1;) {
+        if (isLMS(i)) sa[--bucket[s[i]]] = i;
+    }
+    induce();
+
+    // Name them in order, equal substrings alike; no two LMS positions are adjacent, so pos / 2 is unique
+    size_t m = 0;
+    for (size_t i = 0; i < n; ++i) {
+        if (isLMS(sa[i])) sa[m++] = sa[i];
+    }
+    fill(sa + m, sa + n, empty);
+    uint32_t names = 0, previous = empty;
+    for (size_t i = 0; i < m; ++i) {
+        uint32_t pos = sa[i];
+        bool differs = previous == empty;
+        for (size_t d = 0; !differs; ++d) {
+            if (s[pos + d] != s[previous + d] || stype[pos + d] != stype[previous + d]) {
+                differs = true;
+            } else if (d > 0 && (isLMS(pos + d) || isLMS(previous + d))) {
+                break;
+            }
+        }
+        if (differs) {
+            ++names;
+            previous = pos;
+        }
+        sa[m + pos / 2] = names - 1;
+    }
+    for (size_t i = n, j = n; i-- > m;) {
+        if (sa[i] != empty) sa[--j] = sa[i];
+    }
+
+    // Order the LMS suffixes, recursing while names repeat
+    uint32_t *reduced = sa + n - m;
+    if (names < m) {
+        suffixArrayIS(reduced, sa, m, names);
+    } else {
+        for (size_t i = 0; i < m; ++i) sa[reduced[i]] = i;
+    }
+    for (size_t i = 1, j = 0; i < n; ++i) {
+        if (isLMS(i)) reduced[j++] = i;
+    }
+    for (size_t i = 0; i < m; ++i) sa[i] = reduced[sa[i]];
+    fill(sa + m, sa + n, empty);
+
+    // Induce the full order from the sorted LMS suffixes
+    bucketEnds();
+    for (size_t i = m; i-- > 0;) {
+        uint32_t j = sa[i];
+        sa[i] = empty;
+        sa[--bucket[s[j]]] = j;
+    }
+    induce();
+}
+
+// Bases equal to code among the first count of a packed word
+static inline unsigned countBaseInWord(uint64_t word, unsigned code, size_t count) {
+    static const uint64_t low = 0x5555555555555555ULL;
+    uint64_t x = word ^ (low * code);
+    uint64_t matches = ~(x | x >> 1) & low;
+    if (count < 32) matches &= (1ULL << (2 * count)) - 1;
+    return (unsigned)__builtin_popcountll(matches);
+}
+
+// Read-only view of an index image
+struct FmIndex {
+    const FmHeader *header;
+    const FmBlock *blocks;
+    const uint32_t *samples;
+
+    static size_t blockCount(uint64_t length) { return (length + 1) / fmBlockRows + 1; }
+    static size_t sampleCount(uint64_t length) { return (length + fmSampleRows) / fmSampleRows; }
+    static size_t imageSize(uint64_t length) {
+        return sizeof(FmHeader) + blockCount(length) * sizeof(FmBlock) + sampleCount(length) * sizeof(uint32_t);
+    }
+
+    bool attach(const char *image, size_t size) {
+        header = (const FmHeader *)image;
+        if (size < sizeof(FmHeader) || memcmp(header->magic, fmMagic, sizeof(fmMagic)) != 0 ||
+            header->length >= UINT32_MAX || size != imageSize(header->length)) {
+            return false;
+        }
+        blocks = (const FmBlock *)(image + sizeof(FmHeader));
+        samples = (const uint32_t *)(blocks + blockCount(header->length));
+        return true;
+    }
+
+    unsigned base(uint64_t row) const {
+        return (blocks[row / fmBlockRows].bases[row % fmBlockRows / 32] >> (2 * (row % 32))) & 3;
+    }
+
+    // Rows before row whose BWT base is code
+    uint64_t rank(unsigned code, uint64_t row) const {
+        const FmBlock &block = blocks[row / fmBlockRows];
+        size_t within = row % fmBlockRows;
+        uint64_t r = block.counts[code];
+        for (size_t w = 0; w < within / 32; ++w) r += countBaseInWord(block.bases[w], code, 32);
+        if (within % 32 != 0) r += countBaseInWord(block.bases[within / 32], code, within % 32);
+        if (code == 0 && header->primary < row) --r;
+        return r;
+    }
+
+    // Rows [lo, hi) of the suffixes starting with the motif, by backward search
+    void find(const string &motif, uint64_t &lo, uint64_t &hi) const {
+        lo = 0;
+        hi = header->length + 1;
+        for (size_t i = motif.length(); i-- > 0 && lo < hi;) {
+            unsigned code = nucleotideCodes()[(unsigned char)motif[i]];
+            lo = header->counts[code + 1] + rank(code, lo);
+            hi = header->counts[code + 1] + rank(code, hi);
+        }
+    }
+
+    uint64_t locate(uint64_t row) const {
+        uint64_t steps = 0;
+        while (row % fmSampleRows != 0) {
+            if (row == header->primary) return steps;
+            unsigned code = base(row);
+            row = header->counts[code + 1] + rank(code, row);
+            ++steps;
+        }
+        return samples[row / fmSampleRows] + steps;
+    }
+};
+
+// Index image of a nucleotide sequence
+static bool buildFmIndex(const char *dnaSeq, size_t length, uint64_t sourceSize, string &image) {
+    if (length >= UINT32_MAX) return false;
+    const size_t rows = length + 1;
+    vector<unsigned char> text(rows);
+    for (size_t i = 0; i < length; ++i) {
+        unsigned char code = nucleotideCodes()[(unsigned char)dnaSeq[i]];
+        if (code > 3) return false;
+        text[i] = code + 1;
+    }
+    text[length] = 0;
+    vector<uint32_t> sa(rows);
+    suffixArrayIS(text.data(), sa.data(), rows, 5);
+
+    image.assign(FmIndex::imageSize(length), '\0');
+    FmHeader *header = (FmHeader *)&image[0];
+    FmBlock *blocks = (FmBlock *)(header + 1);
+    uint32_t *samples = (uint32_t *)(blocks + FmIndex::blockCount(length));
+    memcpy(header->magic, fmMagic, sizeof(fmMagic));
+    header->length = length;
+    header->sourceSize = sourceSize;
+    for (size_t row = 0; row < rows; ++row) {
+        if (sa[row] == 0) header->primary = row;
+    }
+
+    // Pack the BWT and count each block, then turn the counts into running totals
+    size_t blockCount = FmIndex::blockCount(length);
+    parallelFor(blockCount, [&](size_t begin, size_t end) {
+        for (size_t b = begin; b < end; ++b) {
+            uint32_t counts[4] = {};
+            for (size_t row = b * fmBlockRows; row < min(rows, (b + 1) * fmBlockRows); ++row) {
+                unsigned code = sa[row] == 0 ? 0 : text[sa[row] - 1] - 1;
+                blocks[b].bases[row % fmBlockRows / 32] |= (uint64_t)code << (2 * (row % 32));
+                ++counts[code];
+            }
+            memcpy(blocks[b].counts, counts, sizeof(counts));
+        }
+    });
+    uint32_t totals[4] = {};
+    for (size_t b = 0; b < blockCount; ++b) {
+        for (int c = 0; c < 4; ++c) {
+            uint32_t count = blocks[b].counts[c];
+            blocks[b].counts[c] = totals[c];
+            totals[c] += count;
+        }
+    }
+    header->counts[0] = 0;
+    header->counts[1] = 1;
+    --totals[0];      // the '$'
+    for (int c = 0; c < 3; ++c) header->counts[c + 2] = header->counts[c + 1] + totals[c];
+
+    parallelFor(FmIndex::sampleCount(length), [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) samples[i] = sa[i * fmSampleRows];
+    });
+    return true;
+}
+
+// Sequence of a .dna file: nucleotides only, up to an optional final newline
+static bool dnaFileSequence(const MappedFile &file, size_t &length) {
+    length = file.size;
+    while (length > 0 && (file.data[length - 1] == '\n' || file.data[length - 1] == '\r')) --length;
+    return length > 0;
+}
+
+bool doFmIndex(const vector<string>& fileNames) {
+    bool all = true;
+    for (const string &fileName : fileNames) {
+        MappedFile file;
+        size_t length;
+        string image;
+        if (!file.open(fileName)) {
+            cerr << "Could not open file: " << fileName << endl;
+            all = false;
+        } else if (!dnaFileSequence(file, length) || !buildFmIndex(file.data, length, file.size, image)) {
+            cerr << fileName << ": not a nucleotide sequence below 4 Gnt, cannot index it" << endl;
+            all = false;
+        } else {
+            ofstream sidecar(fileName + ".fmi", ios::binary);
+            if (!sidecar.write(image.data(), image.length())) {
+                cerr << "Could not write file: " << fileName << ".fmi" << endl;
+                all = false;
+                continue;
+            }
+            cout << fileName << ".fmi: " << length << " nt indexed, " << image.length() << " bytes" << endl;
+        }
+    }
+    return all;
+}
+
+bool doFmFind(const string& motif, const vector<string>& fileNames) {
+    if (motif.empty() || motif.find_first_not_of("ACGT") != string::npos) {
+        cerr << "Invalid motif: expecting a sequence of A, C, G and T." << endl;
+        return false;
+    }
+    const string reverse = reverseComplementOf(motif);
+
+    bool all = true;
+    for (const string &fileName : fileNames) {
+        MappedFile sidecar;
+        FmIndex index;
+        struct stat info;
+        if (!sidecar.open(fileName + ".fmi") || !index.attach(sidecar.data, sidecar.size)) {
+            cerr << fileName << ": no FM-index, build it with --fm-index" << endl;
+            all = false;
+            continue;
+        }
+        if (stat(fileName.c_str(), &info) != 0 || (uint64_t)info.st_size != index.header->sourceSize) {
+            cerr << fileName << ": the FM-index is stale, rebuild it with --fm-index" << endl;
+            all = false;
+            continue;
+        }
+
+        // The reverse complement finds the sites on the other strand, unless the motif is its own
+        size_t total = 0;
+        for (int strand = 0; strand < (reverse == motif ? 1 : 2); ++strand) {
+            uint64_t lo, hi;
+            index.find(strand == 0 ? motif : reverse, lo, hi);
+            vector<uint64_t> sites;
+            for (uint64_t row = lo; row < min(hi, lo + fmLocateLimit); ++row) sites.push_back(index.locate(row));
+            sort(sites.begin(), sites.end());
+            for (uint64_t site : sites) {
+                cout << fileName << ": " << motif << " at " << site << (strand == 0 ? "" : " (reverse strand)") << endl;
+            }
+            if (hi - lo > sites.size()) cout << fileName << ": ... " << hi - lo - sites.size() << " more" << endl;
+            total += hi - lo;
+        }
+        cout << fileName << ": " << total << " site(s) of " << motif << " in " << index.header->length << " nt" << endl;
+    }
+    return all;
+}
+
+/*
+    Base composition.
+
+    A .rank sidecar answers "how many of each base in [i, j)" for any range of a .dna file
+    in constant time: the difference of two ranks, each one superblock counter, one block
+    counter and at most 8 popcounts. It keeps the sequence packed 2 bits a base in blocks
+    of 256, each with 16-bit counts since its superblock of 65536, which holds 64-bit
+    counts since the start; about 2.3 bits a nucleotide in all.
+
+    --rank-index 1 builds it while -i and -c write their output, in the same pass, and
+    after -r has appended. --composition builds it in one streaming pass over a file that
+    has none, or whose sidecar is stale, and then answers from it.
+*/
+
+static const char rankMagic[8] = {'D', 'N', 'A', 'R', 'N', 'K', '1', '\0'};
+static const size_t rankBlockBases = 256;
+static const size_t rankSuperblockBases = 65536;
+
+struct BaseRankHeader {
+    char magic[8];
+    uint64_t length;        // bases counted
+    uint64_t sourceSize;    // size of the counted file, to spot a stale sidecar
+};
+
+void BaseRankBuilder::startBlock() {
+    if (length % rankSuperblockBases == 0) {
+        superblocks.push_back(BaseRankSuperblock());
+        memcpy(superblocks.back().counts, totals, sizeof(totals));
+    }
+    blocks.push_back(BaseRankBlock());
+    for (int c = 0; c < 4; ++c) blocks.back().counts[c] = (uint16_t)(totals[c] - superblocks.back().counts[c]);
+    memset(blocks.back().bases, 0, sizeof(blocks.back().bases));
+}
+
+void BaseRankBuilder::feed(const char *dnaSeq, size_t count) {
+    // A packed word at a time, counted with popcounts once it is filled
+    const unsigned char *codes = nucleotideCodes();
+    while (count > 0) {
+        if (length % rankBlockBases == 0) startBlock();
+        size_t shift = length % 32, take = min<size_t>(count, 32 - shift);
+        uint64_t word = 0;
+        unsigned seen = 0;
+        for (size_t i = 0; i < take; ++i) {
+            unsigned code = codes[(unsigned char)dnaSeq[i]];
+            seen |= code;
+            word |= (uint64_t)(code & 3) << (2 * i);
+        }
+        valid = valid && seen <= 3;
+        for (unsigned c = 0; c < 4; ++c) totals[c] += countBaseInWord(word, c, take);
+        blocks.back().bases[length % rankBlockBases / 32] |= word << (2 * shift);
+        length += take;
+        dnaSeq += take;
+        count -= take;
+    }
+}
+
+string BaseRankBuilder::image(uint64_t sourceSize) {
+    if (length % rankBlockBases == 0) startBlock();     // the end's block, so a rank there needs no special case
+    BaseRankHeader header;
+    memcpy(header.magic, rankMagic, sizeof(rankMagic));
+    header.length = length;
+    header.sourceSize = sourceSize;
+    string image((const char *)&header, sizeof(header));
+    image.append((const char *)superblocks.data(), superblocks.size() * sizeof(BaseRankSuperblock));
+    image.append((const char *)blocks.data(), blocks.size() * sizeof(BaseRankBlock));
+    return image;
+}
+
+bool BaseRankBuilder::write(const string &fileName, uint64_t sourceSize) {
+    if (!valid) return false;
+    string sidecar = image(sourceSize);
+    ofstream out(fileName + ".rank", ios::binary);
+    return (bool)out.write(sidecar.data(), sidecar.length());
+}
+
+// Read-only view of a .rank sidecar
+struct BaseRank {
+    const BaseRankHeader *header;
+    const BaseRankSuperblock *superblocks;
+    const BaseRankBlock *blocks;
+
+    bool attach(const char *image, size_t size) {
+        header = (const BaseRankHeader *)image;
+        if (size < sizeof(BaseRankHeader) || memcmp(header->magic, rankMagic, sizeof(rankMagic)) != 0) return false;
+        uint64_t superblockCount = header->length / rankSuperblockBases + 1, blockCount = header->length / rankBlockBases + 1;
+        if (size != sizeof(BaseRankHeader) + superblockCount * sizeof(BaseRankSuperblock) + blockCount * sizeof(BaseRankBlock)) {
+            return false;
+        }
+        superblocks = (const BaseRankSuperblock *)(header + 1);
+        blocks = (const BaseRankBlock *)(superblocks + superblockCount);
+        return true;
+    }
+
+    // Bases equal to code before position i
+    uint64_t rank(unsigned code, uint64_t i) const {
+        const BaseRankBlock &block = blocks[i / rankBlockBases];
+        size_t within = i % rankBlockBases;
+        uint64_t r = superblocks[i / rankSuperblockBases].counts[code] + block.counts[code];
+        for (size_t w = 0; w < within / 32; ++w) r += countBaseInWord(block.bases[w], code, 32);
+        if (within % 32 != 0) r += countBaseInWord(block.bases[within / 32], code, within % 32);
+        return r;
+    }
+};
+
+// Builds the sidecar of a .dna file in one pass over it
+bool writeRankIndex(const string &fileName) {
+    MappedFile file;
+    size_t length;
+    if (!file.open(fileName) || !dnaFileSequence(file, length)) return false;
+    BaseRankBuilder builder;
+    for (size_t i = 0; i < length; i += 1 << 20) builder.feed(file.data + i, min<size_t>(1 << 20, length - i));
+    return builder.write(fileName, file.size);
+}
+
+// "<start>:<end>", a half-open range of positions
+static bool parseRange(const string &text, uint64_t length, uint64_t &start, uint64_t &end) {
+    size_t colon = text.find(':');
+    if (colon == string::npos || colon == 0 || colon + 1 == text.length() ||
+        text.find_first_not_of("0123456789:") != string::npos || text.find(':', colon + 1) != string::npos ||
+        colon > 19 || text.length() - colon > 20) {
+        return false;
+    }
+    start = stoull(text.substr(0, colon));
+    end = stoull(text.substr(colon + 1));
+    return start <= end && end <= length;
+}
+
+bool doComposition(const string& fileName, const vector<string>& ranges) {
+    MappedFile sidecar;
+    BaseRank index;
+    struct stat info;
+    if (stat(fileName.c_str(), &info) != 0) {
+        cerr << "Could not open file: " << fileName << endl;
+        return false;
+    }
+    if (!sidecar.open(fileName + ".rank") || !index.attach(sidecar.data, sidecar.size) ||
+        index.header->sourceSize != (uint64_t)info.st_size) {
+        if (!writeRankIndex(fileName) || !sidecar.open(fileName + ".rank") || !index.attach(sidecar.data, sidecar.size)) {
+            cerr << fileName << ": not a nucleotide sequence, cannot count its bases" << endl;
+            return false;
+        }
+    }
+
+    const uint64_t length = index.header->length;
+    vector<string> all(1, "0:" + to_string(length));
+    bool valid = true;
+    for (const string &text : ranges.empty() ? all : ranges) {
+        uint64_t start, end;
+        if (!parseRange(text, length, start, end)) {
+            cerr << fileName << ": invalid range " << text << ", expecting <start>:<end> within 0:" << length << endl;
+            valid = false;
+            continue;
+        }
+        uint64_t counts[4];
+        for (unsigned c = 0; c < 4; ++c) counts[c] = index.rank(c, end) - index.rank(c, start);
+        cout << fileName << " [" << start << ", " << end << "): A " << counts[0] << ", C " << counts[1] << ", G "
+             << counts[2] << ", T " << counts[3] << ", GC " << fixed << setprecision(2)
+             << (end > start ? 100.0 * (counts[1] + counts[2]) / (end - start) : 0.0) << defaultfloat << setprecision(6) << "%" << endl;
+    }
+    return valid;
+}
+
+/*
+    k-mer spectrum.
+
+    --kmers <k> counts every k-mer (k up to 31) of .dna files and the oligos of FASTA and
+    FASTQ files, and prints how many distinct k-mers occur once, twice and so on, and the
+    most repeated ones: repeats are where assembly and primers go wrong. A k-mer and its
+    reverse complement are the same site on the other strand and are counted as one.
+
+    The sequence is read in rounds of a few million k-mers. In a round each thread rolls
+    2-bit k-mers over its share and sorts them by the top bits of their hash into one
+    buffer per partition; then each thread takes whole partitions and adds their k-mers to
+    the open-addressing tables it alone owns, so nothing is shared or locked. Memory is the
+    tables, which grow with the distinct k-mers, plus the fixed round buffers.
+
+    With --kmer-bloom <MiB>, a k-mer only enters its table the second time it is seen, so
+    the many singletons of large random payloads stay in a Bloom filter. Singletons are
+    then the k-mers left over, and a false positive counts a singleton as a pair.
+*/
+
+static const size_t kmerPartitionBits = 6;
+static const size_t kmerPartitions = 1 << kmerPartitionBits;
+static const size_t kmerRound = 8 << 20;        // k-mer starts per round
+static const size_t kmerTopCount = 20;          // most repeated k-mers listed
+
+// Open-addressing count table, linear probing; no 62-bit k-mer is all ones
+struct KmerTable {
+    static const uint64_t empty = UINT64_MAX;
+    vector<uint64_t> keys;
+    vector<uint32_t> counts;
+    size_t size;
+
+    KmerTable() : keys(1024, empty), counts(1024, 0), size(0) {}
+
+    void prefetch(uint64_t hash) const { __builtin_prefetch(&keys[hash & (keys.size() - 1)], 1); }
+
+    // One more sighting, the first counting as first
+    void add(uint64_t kmer, uint64_t hash, uint32_t first) {
+        if (10 * (size + 1) > 7 * keys.size()) grow();
+        size_t mask = keys.size() - 1, slot = hash & mask;
+        while (keys[slot] != kmer && keys[slot] != empty) slot = (slot + 1) & mask;
+        if (keys[slot] == empty) {
+            keys[slot] = kmer;
+            counts[slot] = first;
+            ++size;
+        } else if (counts[slot] < UINT32_MAX) {
+            ++counts[slot];
+        }
+    }
+
+    void grow() {
+        vector<uint64_t> oldKeys(keys.size() * 2, empty);
+        vector<uint32_t> oldCounts(counts.size() * 2, 0);
+        oldKeys.swap(keys);
+        oldCounts.swap(counts);
+        size_t mask = keys.size() - 1;
+        for (size_t i = 0; i < oldKeys.size(); ++i) {
+            if (oldKeys[i] == empty) continue;
+            size_t slot = whiteningWord(0, oldKeys[i]) & mask;
+            while (keys[slot] != empty) slot = (slot + 1) & mask;
+            keys[slot] = oldKeys[i];
+            counts[slot] = oldCounts[i];
+        }
+    }
+};
+
+struct KmerCounter {
+    int k;
+    uint64_t mask;
+    size_t threads;
+    vector<KmerTable> tables;               // one per partition
+    vector<vector<uint64_t>> buffers;       // thread * kmerPartitions + partition, for the round
+    vector<vector<uint64_t>> blooms;        // one per partition, empty without --kmer-bloom
+    uint64_t total;                         // k-mers counted, those holding other symbols left out
+
+    KmerCounter(int k, size_t bloomMiB)
+        : k(k), mask((1ULL << (2 * k)) - 1), threads(max(1u, thread::hardware_concurrency())),
+          tables(kmerPartitions), buffers(threads * kmerPartitions), blooms(kmerPartitions), total(0) {
+        if (bloomMiB > 0) {
+            for (vector<uint64_t> &bloom : blooms) bloom.assign((bloomMiB << 20) / 8 / kmerPartitions, 0);
+        }
+    }
+
+    // Canonical k-mers starting in [begin, end), into the thread's partition buffers
+    void extract(const char *dnaSeq, size_t begin, size_t end, size_t t) {
+        const unsigned char *codes = nucleotideCodes();
+        uint64_t forward = 0, reverse = 0;
+        size_t run = 0;
+        for (size_t i = begin; i < end + k - 1; ++i) {
+            unsigned code = codes[(unsigned char)dnaSeq[i]];
+            if (code > 3) {
+                run = 0;
+                continue;
+            }
+            forward = ((forward << 2) | code) & mask;
+            reverse = (reverse >> 2) | ((uint64_t)(3 - code) << (2 * (k - 1)));
+            if (++run < (size_t)k) continue;
+            uint64_t kmer = min(forward, reverse);
+            buffers[t * kmerPartitions + (whiteningWord(0, kmer) >> (64 - kmerPartitionBits))].push_back(kmer);
+        }
+    }
+
+    // Whether the Bloom filter of the partition had the k-mer, which it has from now on
+    static bool bloomSeen(vector<uint64_t> &bloom, uint64_t hash) {
+        const uint64_t bits = bloom.size() * 64;
+        uint64_t step = (hash >> 32) | 1;
+        bool seen = true;
+        for (int probe = 0; probe < 3; ++probe) {
+            uint64_t bit = (hash + probe * step) % bits;
+            seen = seen && (bloom[bit / 64] >> (bit % 64) & 1);
+            bloom[bit / 64] |= 1ULL << (bit % 64);
+        }
+        return seen;
+    }
+
+    // Counts the k-mers of one sequence, which ends every k-mer
+    void count(const char *dnaSeq, size_t length) {
+        if (length < (size_t)k) return;
+        const size_t starts = length - k + 1;
+        for (size_t round = 0; round < starts; round += kmerRound) {
+            size_t roundEnd = min(starts, round + kmerRound);
+            parallelFor(threads, [&](size_t begin, size_t end) {
+                for (size_t t = begin; t < end; ++t) {
+                    extract(dnaSeq, round + (roundEnd - round) * t / threads, round + (roundEnd - round) * (t + 1) / threads, t);
+                }
+            });
+            for (const vector<uint64_t> &buffer : buffers) total += buffer.size();
+            parallelFor(kmerPartitions, [&](size_t begin, size_t end) {
+                for (size_t p = begin; p < end; ++p) {
+                    for (size_t t = 0; t < threads; ++t) {
+                        vector<uint64_t> &buffer = buffers[t * kmerPartitions + p];
+                        for (size_t i = 0; i < buffer.size(); ++i) {
+                            uint64_t kmer = buffer[i], hash = whiteningWord(0, kmer);
+                            if (i + 16 < buffer.size() && blooms[p].empty()) tables[p].prefetch(whiteningWord(0, buffer[i + 16]));
+                            if (blooms[p].empty()) {
+                                tables[p].add(kmer, hash, 1);
+                            } else if (bloomSeen(blooms[p], hash)) {
+                                tables[p].add(kmer, hash, 2);    // the first sighting went to the filter only
+                            }
+                        }
+                        buffer.clear();
+                    }
+                }
+            });
+        }
+    }
+};
+
+bool doKmers(const string& size, const vector<string>& fileNames) {
+    int k;
+    if (!parseIntOption(size.c_str(), 1, 31, k)) {
+        cerr << "Invalid k-mer length: expecting 1-31." << endl;
+        return false;
+    }
+    KmerCounter counter(k, codecOptions.kmerBloom);
+
+    // FASTA and FASTQ oligos are gathered a round at a time, each ended by an N
+    string batch;
+    for (const string &fileName : fileNames) {
+        bool dna = fileName.size() > 4 && fileName.compare(fileName.size() - 4, 4, ".dna") == 0;
+        MappedFile file;
+        size_t length;
+        if (dna ? !file.open(fileName) : !forEachSequence(fileName, [&](const SequenceRecord &read) {
+                batch.append(read.sequence, read.length);
+                batch += 'N';
+                if (batch.length() >= kmerRound) {
+                    counter.count(batch.data(), batch.length());
+                    batch.clear();
+                }
+            })) {
+            cerr << "Could not open file: " << fileName << endl;
+            return false;
+        }
+        if (dna && dnaFileSequence(file, length)) counter.count(file.data, length);
+    }
+    counter.count(batch.data(), batch.length());
+
+    // Spectrum, and the most repeated k-mers, most first
+    map<uint32_t, uint64_t> spectrum;
+    vector<pair<uint32_t, uint64_t>> top;
+    uint64_t distinct = 0, counted = 0;
+    for (const KmerTable &table : counter.tables) {
+        for (size_t i = 0; i < table.keys.size(); ++i) {
+            if (table.keys[i] == KmerTable::empty) continue;
+            ++spectrum[table.counts[i]];
+            ++distinct;
+            counted += table.counts[i];
+            if (table.counts[i] < 2) continue;
+            top.push_back(make_pair(table.counts[i], table.keys[i]));
+            if (top.size() > 4 * kmerTopCount) {
+                nth_element(top.begin(), top.begin() + kmerTopCount, top.end(), greater<pair<uint32_t, uint64_t>>());
+                top.resize(kmerTopCount);
+            }
+        }
+    }
+    if (!counter.blooms[0].empty() && counter.total > counted) {
+        spectrum[1] += counter.total - counted;
+        distinct += counter.total - counted;
+    }
+    sort(top.begin(), top.end(), greater<pair<uint32_t, uint64_t>>());
+    top.resize(min(top.size(), kmerTopCount));
+
+    cout << k << "-mers: " << counter.total << " counted, " << distinct << " distinct (with reverse complements)"
+         << (counter.blooms[0].empty() ? "" : ", singletons by Bloom filter") << endl;
+    cout << "  occurrences\tdistinct" << endl;
+    for (const pair<const uint32_t, uint64_t> &entry : spectrum) cout << "  " << entry.first << "\t" << entry.second << endl;
+    for (const pair<uint32_t, uint64_t> &entry : top) {
+        string kmer(k, 'A');
+        for (int i = 0; i < k; ++i) kmer[i] = nucleotideSymbols[(entry.second >> (2 * (k - 1 - i))) & 3];
+        cout << "  repeat " << kmer << " x" << entry.first << endl;
+    }
+    return true;
+}
+
+/*
+    Benchmarks.
+
+    Throughput of the hot kernels on a deterministic pseudo-random buffer, in MB/s of input.
+*/
+
+static string benchmarkData(size_t length) {
+    string data(length, '\0');
+    uint64_t state = 0x9E3779B97F4A7C15ULL;
+    for (size_t i = 0; i < length; ++i) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        data[i] = (char)state;
+    }
+    return data;
+}
+
+// Best of three runs, so the first run's page faults do not count
+template <typename F>
+static double benchmarkRate(size_t bytes, F kernel) {
+    double best = 0;
+    for (int run = 0; run < 3; ++run) {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        kernel();
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        best = max(best, bytes / seconds / 1e6);
+    }
+    return best;
+}
+
+bool doBenchmark(const string& kernel) {
+    const size_t length = 64 << 20;
+    const string data = benchmarkData(length);
+
+    if (kernel == "codec") {
+        string dnaSeq, bytes;
+        double encode = benchmarkRate(length, [&]() { dnaSeq = bytesToNucleotide(data); });
+        double decode = benchmarkRate(length, [&]() { nucleotideToBytes(dnaSeq.data(), dnaSeq.length(), bytes); });
+        cout << "codec: encode " << encode << " MB/s, decode " << decode << " MB/s" << endl;
+    } else if (kernel == "rs") {
+        const int parities[] = {4, 8, 16, 32, 64};
+        for (int parity : parities) {
+            string encoded, decoded;
+            size_t corrected = 0;
+            double encode = benchmarkRate(length, [&]() { encoded = rsEncode(data, parity); });
+            double check = benchmarkRate(length, [&]() { rsDecode(encoded, parity, decoded, corrected); });
+
+            // One substituted byte in every codeword
+            size_t codewords = encoded.length() / 255;
+            for (size_t first = 0; first < codewords; first += rsInterleave) {
+                size_t depth = min(rsInterleave, codewords - first);
+                for (size_t lane = 0; lane < depth; ++lane) encoded[first * 255 + (lane * 7 % 255) * depth + lane] ^= 0x5a;
+            }
+            double correct = benchmarkRate(length, [&]() { rsDecode(encoded, parity, decoded, corrected); });
+
+            cout << "rs=" << parity << ": encode " << encode << " MB/s, clean decode " << check
+                 << " MB/s, decode with 1 error/codeword " << correct << " MB/s" << endl;
+        }
+    } else if (kernel == "erasure") {
+        const size_t stripeLength = 64;
+        const int dataStripes = 32;
+        const int parities[] = {1, 2, 4, 8, 16};
+        for (int parity : parities) {
+            ErasureCode code = makeErasureCode(dataStripes, parity);
+            string encoded;
+            double encode = benchmarkRate(length, [&]() { encoded = erasureEncodeStripes(data, stripeLength, code); });
+
+            // Drop as many stripes per group as there are parity stripes, data first
+            vector<bool> present(encoded.length() / stripeLength, true);
+            string damaged = encoded;
+            for (size_t first = 0; first < present.size(); first += dataStripes + parity) {
+                for (int d = 0; d < parity; ++d) present[first + d * 3 % dataStripes] = false;
+            }
+            size_t rebuilt = 0;
+            double rebuild = benchmarkRate(length, [&]() {
+                vector<bool> missing = present;
+                erasureRebuildStripes(damaged, missing, stripeLength, code, rebuilt);
+            });
+            cout << "erasure " << dataStripes << "+" << parity << ": encode " << encode << " MB/s, rebuild "
+                 << parity << " lost/group " << rebuild << " MB/s" << (damaged == encoded ? "" : " (MISMATCH)") << endl;
+        }
+    } else if (kernel == "oligo") {
+        OligoLayout layout = oligoLayoutFor(CodecOptions());
+        string stripes = segmentRecord(data, layout);
+        size_t count = stripes.length() / layout.stripeLength;
+        ostringstream fasta;
+        double rate = benchmarkRate(count, [&]() {
+            fasta.str(string());
+            writeOligoFasta(fasta, stripes, layout);
+        });
+        cout << "oligo: " << rate * 60 << " million " << oligoSequenceLength(layout) << " nt oligos/minute" << endl;
+    } else if (kernel == "fountain") {
+        // 4 MB record, droplets 25% over the segment count, every tenth droplet lost before decoding
+        CodecOptions options;
+        options.fountainOverhead = 25;
+        OligoLayout layout = oligoLayoutFor(options);
+        const string record = data.substr(0, 4 << 20);
+        string droplets;
+        vector<uint32_t> seeds;
+        double encode = benchmarkRate(record.length(), [&]() { fountainEncode(record, layout, options, droplets, seeds); });
+
+        size_t seedCount = seeds.back() + 1;
+        string stripes(seedCount * layout.stripeLength, '\0');
+        vector<bool> present(seedCount, false);
+        for (size_t i = 0; i < seeds.size(); ++i) {
+            if (i % 10 == 0) continue;
+            memcpy(&stripes[seeds[i] * layout.stripeLength], droplets.data() + i * layout.stripeLength, layout.stripeLength);
+            present[seeds[i]] = true;
+        }
+        string decoded;
+        vector<size_t> erasures;
+        FountainStats stats;
+        double decode = benchmarkRate(record.length(), [&]() {
+            erasures.clear();
+            fountainDecode(stripes, present, layout.stripeLength, decoded, erasures, stats);
+        });
+        bool match = erasures.empty() && decoded.compare(0, record.length(), record) == 0;
+        cout << "fountain " << stats.segments << " segments: encode " << encode << " MB/s (" << seeds.size()
+             << " droplets from " << seedCount << " seeds), decode 90% " << decode << " MB/s"
+             << (match ? "" : " (MISMATCH)") << endl;
+    } else if (kernel == "consensus") {
+        // eight damaged copies of each 200 nt oligo
+        OligoLayout layout = oligoLayoutFor(CodecOptions());
+        size_t byteCount = oligoAddressBytes + layout.stripeLength + oligoChecksumBytes, copyCount = 8;
+        size_t oligos = length / (byteCount * copyCount);
+        vector<const unsigned char *> copies(copyCount);
+        string consensus(byteCount, '\0');
+        double rate = benchmarkRate(oligos * byteCount * copyCount, [&]() {
+            for (size_t i = 0; i < oligos; ++i) {
+                for (size_t c = 0; c < copyCount; ++c) {
+                    copies[c] = (const unsigned char *)data.data() + (i * copyCount + c) * byteCount;
+                }
+                consensusOligo(copies, byteCount, (unsigned char *)&consensus[0]);
+            }
+        });
+        cout << "consensus: " << rate << " MB/s of " << copyCount << "-copy reads, "
+             << rate * 60 / (byteCount * copyCount) << " million oligos/minute" << endl;
+
+        string quality(length / 4, 30);
+        vector<DamagedCopy> group(copyCount);
+        vector<bool> weak;
+        double soft = benchmarkRate(oligos * byteCount * copyCount, [&]() {
+            for (size_t i = 0; i < oligos; ++i) {
+                for (size_t c = 0; c < copyCount; ++c) {
+                    group[c].bytes = (const unsigned char *)data.data() + (i * copyCount + c) * byteCount;
+                    group[c].quality = (const uint8_t *)quality.data() + (i * copyCount + c) * byteCount;
+                }
+                softConsensusOligo(group, byteCount, (unsigned char *)&consensus[0], weak);
+            }
+        });
+        cout << "soft consensus: " << soft << " MB/s of " << copyCount << "-copy reads, "
+             << soft * 60 / (byteCount * copyCount) << " million oligos/minute" << endl;
+    } else if (kernel == "align") {
+        // 184 nt payloads of 200 nt oligos, each read with a deletion, an insertion and two substitutions
+        const size_t m = 184, count = 100000;
+        const SoftTables &tables = softTables();
+        vector<uint8_t> reference(m * count), reads((m + 1) * count), weights(m + 1, 30);
+        for (size_t i = 0; i < m * count; ++i) reference[i] = tables.codes[(uint8_t)data[i / 4]][i % 4];
+        for (size_t r = 0; r < count; ++r) {
+            const uint8_t *ref = &reference[r * m];
+            uint8_t *read = &reads[r * (m + 1)];
+            size_t cut = 40 + r % 50, extra = 120 + r % 40;
+            memcpy(read, ref, cut);
+            memcpy(read + cut, ref + cut + 1, extra - cut - 1);
+            read[extra - 1] = (ref[extra] + 1) & 3;
+            memcpy(read + extra, ref + extra - 1, m - extra + 1);
+            read[10] ^= 1;
+            read[170] ^= 2;
+        }
+        Aligner aligner;
+        vector<uint8_t> codes(m), projected(m), deleted(m), inserted(m + 1);
+        size_t edits = 0;
+        double rate = benchmarkRate(count, [&]() {
+            edits = 0;
+            for (size_t r = 0; r < count; ++r) {
+                edits += aligner.project(&reference[r * m], m, &reads[r * (m + 1)], weights.data(), m + 1, m / 4,
+                                         codes.data(), projected.data(), deleted.data(), inserted.data());
+            }
+        });
+
+        // Reads with up to 8 random edits, against the edit distance of the full table
+        bool same = true;
+        vector<long> row(m + maxIndels + 1), next(row.size());
+        weights.assign(m + maxIndels, 30);
+        for (size_t t = 0; t < 300 && same; ++t) {
+            const uint8_t *ref = &reference[t * m];
+            const unsigned char *random = (const unsigned char *)data.data() + length / 2 + t * 64;
+            vector<uint8_t> read(ref, ref + m);
+            for (size_t e = 0; e < t % 9; ++e) {
+                size_t at = random[32 + e] * read.size() / 256;
+                if (random[e] % 3 == 0) read[at] = (read[at] + 1 + random[e] / 3 % 3) & 3;
+                else if (random[e] % 3 == 1) read.erase(read.begin() + at);
+                else read.insert(read.begin() + at, random[e] / 3 & 3);
+            }
+            const size_t n = read.size();
+            for (size_t i = 0; i <= m; ++i) row[i] = i;
+            for (size_t j = 1; j <= n; ++j) {
+                next[0] = j;
+                for (size_t i = 1; i <= m; ++i) {
+                    next[i] = min(min(row[i], next[i - 1]) + 1, row[i - 1] + (ref[i - 1] != read[j - 1]));
+                }
+                row.swap(next);
+            }
+            same = aligner.project(ref, m, read.data(), weights.data(), n, m, codes.data(), projected.data(),
+                                   deleted.data(), inserted.data()) == (size_t)row[m];
+        }
+        cout << "align: " << rate << " million " << m << " nt alignments/second, " << (double)edits / count << " edits each"
+             << (same ? "" : " (MISMATCH)") << endl;
+    } else if (kernel == "flank") {
+        // 200 nt framed reads, as written and with adapter bases around the flanks
+        const size_t count = 200000, payload = 176;
+        const string &promoter = flankSet.promoter, trailer = flankSet.terminator + flankSet.marker;
+        string exact, adapted;
+        vector<size_t> exactEnds, adaptedEnds;
+        for (size_t r = 0; r < count; ++r) {
+            string body = bytesToNucleotide(data.substr(r * payload / 4, payload / 4));
+            string junk = bytesToNucleotide(data.substr(length - 1 - r % 4096, 8));
+            exact += promoter + body + trailer;
+            exactEnds.push_back(exact.length());
+            adapted += junk.substr(0, 12 + r % 20) + promoter + body + trailer + junk.substr(0, r % 16);
+            adaptedEnds.push_back(adapted.length());
+        }
+        size_t found = 0;
+        auto locateAll = [&](const string &reads, const vector<size_t> &ends) {
+            found = 0;
+            for (size_t r = 0, begin = 0; r < count; begin = ends[r++]) {
+                size_t start, payloadLength;
+                found += locateFlanks(reads.data() + begin, ends[r] - begin, start, payloadLength) && payloadLength == payload;
+            }
+        };
+        double fast = benchmarkRate(exact.length(), [&]() { locateAll(exact, exactEnds); });
+        size_t fastFound = found;
+        double searched = benchmarkRate(adapted.length(), [&]() { locateAll(adapted, adaptedEnds); });
+        cout << "flank: " << fast / 1000 << " GB/s of framed reads (" << fastFound << " found), " << searched
+             << " MB/s with adapter bases (" << found << " of " << count << " found)" << endl;
+    } else if (kernel == "revcomp") {
+        // in place and twice per run, so every run starts from the same strand
+        string ascii = bytesToNucleotide(data);
+        string packed = data;
+        double text = benchmarkRate(2 * ascii.length(), [&]() {
+            reverseComplement(&ascii[0], ascii.length());
+            reverseComplement(&ascii[0], ascii.length());
+        });
+        double bytes = benchmarkRate(2 * packed.length(), [&]() {
+            reverseComplementPacked((unsigned char *)&packed[0], packed.length());
+            reverseComplementPacked((unsigned char *)&packed[0], packed.length());
+        });
+        bool same = ascii == bytesToNucleotide(data) && packed == data;
+        cout << "revcomp: " << text << " MB/s of nucleotides, " << bytes << " MB/s of packed bytes"
+             << (same ? "" : " (MISMATCH)") << endl;
+    } else if (kernel == "escape") {
+        // bytes to escaped nucleotides against the plain byte codec, then back
+        string plain, escaped, unescaped;
+        double coded = benchmarkRate(length, [&]() { plain = bytesToNucleotide(data); });
+        bool valid = true;
+        double escaping = benchmarkRate(length, [&]() {
+            escaped.clear();
+            valid = escapeFlanks(data, escaped);
+        });
+        double unescaping = benchmarkRate(length, [&]() {
+            unescaped.clear();
+            valid = unescapeFlanks(escaped.data(), escaped.length(), unescaped) && valid;
+        });
+        for (const string *flank : {&flankSet.promoter, &flankSet.terminator, &flankSet.marker}) {
+            valid = valid && findFlank(escaped.data(), escaped.length(), *flank) == string::npos;
+        }
+        cout << "escape: " << escaping << " MB/s escaped (" << coded << " MB/s plain), " << unescaping
+             << " MB/s unescaped, " << escaped.length() - plain.length() << " bases stuffed"
+             << (valid && unescaped == plain ? "" : " (MISMATCH)") << endl;
+    } else if (kernel == "whiten") {
+        // keystream XOR against the plain byte codec it runs in front of, then the composition of zeros
+        string whitened = data, dnaSeq;
+        double rate = benchmarkRate(length, [&]() { whitenBytes(&whitened[0], whitened.length(), 1); });
+        double coded = benchmarkRate(length, [&]() { dnaSeq = bytesToNucleotide(data); });
+        string zeros(1 << 20, '\0');
+        whitenBytes(&zeros[0], zeros.length(), 1, 12345);
+        string shifted(zeros.length() - 5, '\0');
+        whitenBytes(&shifted[0], shifted.length(), 1, 12350);
+        dnaSeq = bytesToNucleotide(zeros);
+        size_t run = 1, longest = 1, gc = 0;
+        for (size_t i = 0; i < dnaSeq.length(); ++i) {
+            run = i > 0 && dnaSeq[i] == dnaSeq[i - 1] ? run + 1 : 1;
+            longest = max(longest, run);
+            gc += dnaSeq[i] == 'C' || dnaSeq[i] == 'G';
+        }
+        cout << "whiten: " << rate << " MB/s (" << 100.0 * coded / rate << "% of the plain codec at " << coded
+             << " MB/s), zeros whiten to longest run " << longest << ", GC " << 100.0 * gc / dnaSeq.length() << "%"
+             << (shifted == zeros.substr(5) ? "" : " (MISMATCH)") << endl;
+    } else if (kernel == "screen") {
+        // GC windows, runs and ten 6-nt restriction sites over plain-coded random data, nothing listed
+        string dnaSeq = bytesToNucleotide(data.substr(0, length / 4));
+        const char *sites[] = {"GAATTC", "GGATCC", "AAGCTT", "GGTCTC", "CGTCTC", "GCTCTTC", "CTGCAG", "GAGCTC", "TCTAGA", "CCCGGG"};
+        vector<ScreenMotif> motifs;
+        for (const char *site : sites) motifs.push_back({site, site});
+        MotifMatcher matcher(motifs);
+        ScreenSummary summary;
+        double rate = benchmarkRate(dnaSeq.length(), [&]() {
+            summary = ScreenSummary();
+            summary.reportLimit = 0;
+            SequenceScreen screen(matcher, motifs, codecOptions, summary, "");
+            for (size_t i = 0; i < dnaSeq.length(); i += 4 << 20) screen.feed(dnaSeq.data() + i, min<size_t>(4 << 20, dnaSeq.length() - i));
+            screen.finish();
+        });
+
+        // Short sequences drifting in GC, fed in odd chunks, against every window counted on its own
+        bool same = true;
+        for (size_t t = 0; t < 300 && same; ++t) {
+            CodecOptions options = codecOptions;
+            options.gcWindow = 10 + t % 90;      // windows shorter and longer than a 64-base block
+            options.gcMin = 30;
+            options.gcMax = 70;
+            options.maxRun = 4;
+            const size_t window = options.gcWindow, n = 100 + (unsigned char)data[t] * 4;
+            string sample(n, 'A');
+            for (size_t i = 0; i < n; ++i) {
+                unsigned char r = data[t * 4096 + i];
+                bool gc = (r & 3) < (i / 97 + t) % 5;
+                sample[i] = "ATGC"[(gc ? 2 : 0) + (r >> 7)];
+            }
+            const size_t lowCount = (options.gcMin * window + 99) / 100, highCount = options.gcMax * window / 100;
+            size_t windows = 0, lowest = SIZE_MAX, highest = 0, stretches = 0, runs = 0, longest = 0;
+            int side = 0;
+            for (size_t w = 0; w + window <= n; ++w) {
+                size_t count = 0;
+                for (size_t i = w; i < w + window; ++i) count += sample[i] == 'C' || sample[i] == 'G';
+                int now = count < lowCount ? -1 : count > highCount ? 1 : 0;
+                if (now != 0 && now != side) ++stretches;
+                side = now;
+                ++windows;
+                lowest = min(lowest, count);
+                highest = max(highest, count);
+            }
+            for (size_t i = 0, j; i < n; i = j) {
+                for (j = i + 1; j < n && sample[j] == sample[i]; ++j) {}
+                runs += j - i > (size_t)options.maxRun;
+                longest = max(longest, j - i);
+            }
+
+            ScreenSummary check;
+            check.reportLimit = 0;
+            SequenceScreen screen(matcher, motifs, options, check, "");
+            for (size_t i = 0, chunk; i < n; i += chunk) {
+                chunk = min<size_t>(1 + (unsigned char)data[t * 4096 + i] % 150, n - i);
+                screen.feed(sample.data() + i, chunk);
+            }
+            screen.finish();
+            same = check.windows == windows && check.lowestWindow == lowest && check.highestWindow == highest &&
+                   check.gcViolations == stretches && check.runViolations == runs && check.longestRun == longest;
+        }
+        cout << "screen: " << rate << " MB/s of nucleotides, " << summary.gcViolations << " GC stretches, "
+             << summary.runViolations << " runs, " << summary.motifSites << " motif sites" << (same ? "" : " (MISMATCH)") << endl;
+    } else if (kernel == "grep") {
+        // 16 MB of plain-coded random data searched for a 7-byte pattern placed at every 1 MB, against decode + search
+        string bytes = data.substr(0, length / 4);
+        const string needle = "\x01needle";
+        for (size_t i = 1000; i + needle.length() <= bytes.length(); i += 1 << 20) bytes.replace(i, needle.length(), needle);
+        string dnaSeq = bytesToNucleotide(bytes), pattern = bytesToNucleotide(needle), decoded;
+        vector<size_t> hits;
+        double encoded = benchmarkRate(bytes.length(), [&]() {
+            hits.clear();
+            findAligned(dnaSeq.data(), dnaSeq.length(), pattern, hits);
+        });
+        size_t found = 0;
+        double decoding = benchmarkRate(bytes.length(), [&]() {
+            nucleotideToBytes(dnaSeq.data(), dnaSeq.length(), decoded);
+            found = 0;
+            for (size_t at = decoded.find(needle); at != string::npos; at = decoded.find(needle, at + 1)) ++found;
+        });
+        cout << "grep: " << encoded << " MB/s in the encoded domain, " << decoding << " MB/s decoding first, "
+             << hits.size() << " match(es)" << (hits.size() == found ? "" : " (MISMATCH)") << endl;
+    } else if (kernel == "fmindex") {
+        // index of 16 Mnt of plain-coded random data, then counts and locates of 12-mers taken from it
+        string dnaSeq = bytesToNucleotide(data.substr(0, length / 16)), image;
+        double build = benchmarkRate(dnaSeq.length(), [&]() { buildFmIndex(dnaSeq.data(), dnaSeq.length(), 0, image); });
+        FmIndex index;
+        index.attach(image.data(), image.length());
+        const size_t queries = 100000;
+        size_t sites = 0;
+        bool valid = true;
+        double count = benchmarkRate(queries, [&]() {
+            sites = 0;
+            for (size_t q = 0; q < queries; ++q) {
+                uint64_t lo, hi;
+                index.find(dnaSeq.substr(q * 157, 12), lo, hi);
+                sites += hi - lo;
+            }
+        });
+        double locate = benchmarkRate(queries, [&]() {
+            for (size_t q = 0; q < queries; ++q) {
+                uint64_t lo, hi;
+                index.find(dnaSeq.substr(q * 157, 12), lo, hi);
+                bool found = false;
+                for (uint64_t row = lo; row < hi; ++row) found = found || index.locate(row) == q * 157;
+                valid = valid && found;
+            }
+        });
+        cout << "fmindex: build " << build << " MB/s of nucleotides, " << 8.0 * image.length() / dnaSeq.length() << " bits/nt, "
+             << count << " million 12-mer counts/s, " << locate << " million counts with locate/s, " << sites << " sites"
+             << (valid ? "" : " (MISMATCH)") << endl;
+    } else if (kernel == "rank") {
+        // rank sidecar of 64 Mnt of plain-coded random data, then GC counts of pseudo-random ranges
+        string dnaSeq = bytesToNucleotide(data.substr(0, length / 4));
+        BaseRankBuilder builder;
+        double build = benchmarkRate(dnaSeq.length(), [&]() {
+            builder = BaseRankBuilder();
+            builder.feed(dnaSeq);
+        });
+        string image = builder.image(0);
+        BaseRank index;
+        bool valid = index.attach(image.data(), image.length());
+
+        const size_t queries = 1 << 22;
+        uint64_t gc = 0, state = 0x9E3779B97F4A7C15ULL;
+        double query = benchmarkRate(queries, [&]() {
+            gc = 0;
+            for (size_t q = 0; q < queries; ++q) {
+                state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+                uint64_t start = (state >> 33) % dnaSeq.length(), end = start + (state & 0xFFFFF) % (dnaSeq.length() - start + 1);
+                gc += index.rank(1, end) - index.rank(1, start) + index.rank(2, end) - index.rank(2, start);
+            }
+        });
+        for (size_t start = 0; valid && start < dnaSeq.length(); start += 9973 * 131) {
+            size_t end = min(dnaSeq.length(), start + 70000);
+            valid = index.rank(2, end) - index.rank(2, start) == (uint64_t)count(dnaSeq.begin() + start, dnaSeq.begin() + end, 'G');
+        }
+        cout << "rank: build " << build << " MB/s of nucleotides, " << query << " million GC counts/s, "
+             << 8.0 * image.length() / dnaSeq.length() << " bits/nt" << (valid ? "" : " (MISMATCH)") << endl;
+    } else if (kernel == "kmers") {
+        // canonical 21-mers of 8 Mnt of plain-coded random data, nearly all singletons, with and without a Bloom filter
+        string dnaSeq = bytesToNucleotide(data.substr(0, length / 32));
+        size_t plainDistinct = 0, bloomDistinct = 0;
+        double plain = benchmarkRate(dnaSeq.length(), [&]() {
+            KmerCounter counter(21, 0);
+            counter.count(dnaSeq.data(), dnaSeq.length());
+            plainDistinct = 0;
+            for (const KmerTable &table : counter.tables) plainDistinct += table.size;
+        });
+        double bloom = benchmarkRate(dnaSeq.length(), [&]() {
+            KmerCounter counter(21, 64);
+            counter.count(dnaSeq.data(), dnaSeq.length());
+            bloomDistinct = 0;
+            for (const KmerTable &table : counter.tables) bloomDistinct += table.size;
+        });
+        cout << "kmers: " << plain << " MB/s of nucleotides, " << plainDistinct << " distinct in the tables; with a 64 MiB Bloom filter "
+             << bloom << " MB/s, " << bloomDistinct << " in the tables" << endl;
+    } else if (kernel == "codons") {
+        // codon indices, usage and translation of plain-coded random data
+        string dnaSeq = bytesToNucleotide(data.substr(0, length / 4));
+        size_t codons = dnaSeq.length() / 3;
+        vector<unsigned char> indices(codons), protein(codons);
+        size_t counts[invalidCodon + 1] = {};
+        double index = benchmarkRate(dnaSeq.length(), [&]() { codonIndices(dnaSeq.data(), codons, indices.data()); });
+        double usage = benchmarkRate(dnaSeq.length(), [&]() {
+            for (size_t i = 0; i < codons; ++i) ++counts[indices[i]];
+        });
+        double translate = benchmarkRate(dnaSeq.length(), [&]() {
+            lookupCodons(indices.data(), codons, (const unsigned char *)geneticCode, protein.data());
+        });
+        bool valid = true;
+        for (size_t i = 0; i < codons; i += 9973) {
+            valid = valid && protein[i] == geneticCode[16 * nucleotideCodes()[(unsigned char)dnaSeq[3 * i]] +
+                                                       4 * nucleotideCodes()[(unsigned char)dnaSeq[3 * i + 1]] +
+                                                       nucleotideCodes()[(unsigned char)dnaSeq[3 * i + 2]]];
+        }
+        cout << "codons: index " << index << " MB/s, usage " << usage << " MB/s, translate " << translate
+             << " MB/s of nucleotides, " << counts[48] / 3 << " TAA" << (valid ? "" : " (MISMATCH)") << endl;
+    } else if (kernel == "sense") {
+        // bytes to sense codons against the plain byte codec, then back, with the density of each
+        string plain, bytes(length, '\0'), sense(length / 2 * 9, 'A');
+        double plainEncode = benchmarkRate(length, [&]() { plain = bytesToNucleotide(data); });
+        double plainDecode = benchmarkRate(length, [&]() { nucleotideToBytes(plain.data(), plain.length(), bytes); });
+        double encode = benchmarkRate(length, [&]() { bytesToSense((const unsigned char *)data.data(), length, &sense[0]); });
+        bool valid = true;
+        double decode = benchmarkRate(length, [&]() { valid = senseToBytes(sense.data(), sense.length(), (unsigned char *)&bytes[0]); });
+        size_t stops = 0;
+        for (size_t i = 0; i < sense.length(); i += 3) {
+            stops += sense[i] == 'T' && ((sense[i + 1] == 'A' && (sense[i + 2] == 'A' || sense[i + 2] == 'G')) ||
+                                         (sense[i + 1] == 'G' && sense[i + 2] == 'A'));
+        }
+        cout << "sense: encode " << encode << " MB/s, decode " << decode << " MB/s (plain " << plainEncode << " and "
+             << plainDecode << " MB/s), " << 8.0 * length / sense.length() << " bits/nt against " << 8.0 * length / plain.length()
+             << ", " << 100.0 * sense.length() / plain.length() - 100 << "% more bases, " << stops << " stop codons"
+             << (valid && bytes == data ? "" : " (MISMATCH)") << endl;
+    } else if (kernel == "rotating") {
+        // bytes to rotating-code nucleotides against the plain byte codec, then back, for random and zero data
+        const size_t blocks = length / 3 * 3;
+        for (int zeros = 0; zeros < 2; ++zeros) {
+            string input = zeros ? string(blocks, '\0') : data.substr(0, blocks), plain, bytes, rotating(blocks / 3 * 16, 'A');
+            bytes.resize(blocks);
+            bool valid = true;
+            double plainEncode = benchmarkRate(blocks, [&]() { plain = bytesToNucleotide(input); });
+            double plainDecode = benchmarkRate(blocks, [&]() { nucleotideToBytes(plain.data(), plain.length(), bytes); });
+            double encode = benchmarkRate(blocks, [&]() {
+                unsigned char previous = 0;
+                bytesToRotating((const unsigned char *)input.data(), blocks, &rotating[0], previous);
+            });
+            double decode = benchmarkRate(blocks, [&]() {
+                unsigned char previous = 0;
+                valid = rotatingToBytes(rotating.data(), rotating.length(), (unsigned char *)&bytes[0], previous);
+            });
+            size_t run = 1, longest = 1, gc = 0;
+            for (size_t i = 0; i < rotating.length(); ++i) {
+                run = i > 0 && rotating[i] == rotating[i - 1] ? run + 1 : 1;
+                longest = max(longest, run);
+                gc += rotating[i] == 'C' || rotating[i] == 'G';
+            }
+            cout << "rotating" << (zeros ? " (zeros)" : "") << ": encode " << encode << " MB/s, decode " << decode
+                 << " MB/s (plain " << plainEncode << " and " << plainDecode << " MB/s), longest run " << longest
+                 << ", GC " << 100.0 * gc / rotating.length() << "%" << (valid && bytes == input ? "" : " (MISMATCH)") << endl;
+        }
+    } else if (kernel == "cluster") {
+        // five copies of each 200 nt oligo with two substituted bytes, one copy in ten with a damaged index
+        const size_t byteCount = 46, copyCount = 5, oligos = 200000, reads = oligos * copyCount;
+        string copies(reads * byteCount, '\0');
+        vector<DamagedCopy> group(reads);
+        for (size_t r = 0; r < reads; ++r) {
+            unsigned char *bytes = (unsigned char *)&copies[r * byteCount];
+            memcpy(bytes, data.data() + r / copyCount * byteCount, byteCount);
+            uint32_t index = (uint32_t)(r / copyCount);
+            if (r % 10 == 3) index ^= (uint32_t)data[r] << 8 | 0x10000;
+            for (int b = 0; b < 4; ++b) bytes[b] = (unsigned char)(index >> (24 - 8 * b));
+            bytes[8 + r * 7 % 30] ^= 0x40;
+            bytes[12 + r * 5 % 30] ^= 0x02;
+            group[r].bytes = bytes;
+            group[r].index = oligoIndex(bytes);
+        }
+        size_t moved = 0;
+        double rate = benchmarkRate(reads, [&]() {
+            vector<DamagedCopy> clustered = group;
+            moved = clusterDamagedCopies(clustered, byteCount * 4, (size_t)codecOptions.clusterMemory << 20);
+        });
+        cout << "cluster: " << rate << " million reads/second, " << moved << " of " << reads / 10 << " damaged indices regrouped" << endl;
+    } else if (kernel == "fastq") {
+        // 200 nt reads in four-line FASTQ records, parsed from a temporary file
+        char path[] = "/tmp/dna_codec_benchXXXXXX";
+        int fd = mkstemp(path);
+        if (fd < 0) {
+            cerr << "Could not create temporary file." << endl;
+            return false;
+        }
+        string fastq;
+        for (size_t i = 0; fastq.length() < length; i += 50) {
+            fastq += "@read_" + to_string(i) + "\n" + bytesToNucleotide(data.substr(i, 50)) + "\n+\n" + string(200, 'I') + "\n";
+        }
+        bool written = write(fd, fastq.data(), fastq.length()) == (ssize_t)fastq.length();
+        close(fd);
+
+        size_t records = 0, bases = 0;
+        double rate = written ? benchmarkRate(fastq.length(), [&]() {
+            records = bases = 0;
+            forEachSequence(path, [&](const SequenceRecord &read) {
+                ++records;
+                bases += read.length;
+            });
+        }) : 0;
+        unlink(path);
+        cout << "fastq: " << rate << " MB/s, " << records << " reads, " << bases << " bases" << endl;
+    } else {
+        cerr << "Unknown benchmark kernel: " << kernel << " (expecting codec, rs, erasure, oligo, fountain, consensus, align, cluster, flank, revcomp, escape, rotating, sense, whiten, screen, codons, grep, fmindex, rank, kmers or fastq)" << endl;
+        return false;
+    }
+    return true;
+}